@@ -0,0 +1,45 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Compare balance against balanceParallel on an increasing number of threads, for
+//   a rope built from many small leaves by random insertions
+//
+// usage: balance_bench [leaves] [max threads]
+
+#include "bench.hpp"
+#include <cstdlib>
+
+using namespace bench;
+
+int main(int argc, char * argv[]) {
+  size_t leaves = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  size_t maxThreads = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 32;
+  std::mt19937 gen(1);
+
+  // inserting at random positions of a balanced document splits its leaves, so the
+  //   rope ends up with many leaves and is then unbalanced with a short chain
+  rope doc = makeDocument(leaves * 16, 64, gen);
+  for (size_t i = 0; i < leaves / 4; i++) doc.insert(gen() % doc.length(), "x");
+  doc.append(makeText(1, gen));
+  rope chain = rope(makeText(1, gen));
+  for (size_t i = 0; i < 64; i++) chain.append(makeText(1, gen));
+  chain.append(doc);
+  doc = chain;
+
+  std::printf("document: %zu bytes, balanced: %s\n", doc.length(), doc.isBalanced() ? "yes" : "no");
+  std::printf("%16s %12s\n", "threads", "time (ms)");
+  rope serial = doc;
+  double serialMs = timeMs([&] { serial.balance(); });
+  std::printf("%16s %12.3f\n", "balance", serialMs);
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+    proj::task_pool pool(threads);
+    rope copy = doc;
+    double ms = timeMs([&] { copy.balanceParallel(pool); });
+    std::printf("%16zu %12.3f\n", threads, ms);
+  }
+  return 0;
+}
@@ -0,0 +1,59 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Compare join balancing against path rebuilding under each rebalance policy, for a
+//   random mix of insertions and deletions
+//
+// usage: balancing_bench [edits] [document length] [period]
+
+#include "bench.hpp"
+#include <cstdlib>
+
+using namespace bench;
+
+// Apply (edits) random small insertions and deletions to the given rope
+double runEdits(rope& doc, size_t edits, std::mt19937& gen) {
+  return timeMs([&] {
+    for (size_t i = 0; i < edits; i++) {
+      size_t pos = gen() % doc.length();
+      if (i % 2 == 0) {
+        doc.insert(pos, makeText(1 + gen() % 8, gen));
+      } else {
+        doc.rdelete(pos, std::min(doc.length() - pos, size_t(1 + gen() % 8)));
+      }
+    }
+  });
+}
+
+int main(int argc, char * argv[]) {
+  size_t edits = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 100000;
+  size_t len = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 1 << 20;
+  size_t period = (argc > 3) ? std::strtoull(argv[3], nullptr, 10) : 1000;
+  std::mt19937 gen(1);
+  rope doc = makeDocument(len, 64, gen);
+
+  std::printf("%zu edits on a document of %zu bytes\n", edits, len);
+  std::printf("%24s %12s %10s %12s %14s\n", "mode", "time (ms)", "balanced", "rebalances", "rebalance (ms)");
+  struct config { const char * name; proj::balancing mode; proj::rebalance_policy policy; };
+  const config configs[] = {
+    { "rebuild, never", proj::balancing::rebuild, { proj::rebalance_trigger::never, 0 } },
+    { "rebuild, depth 45", proj::balancing::rebuild, { proj::rebalance_trigger::depth, 45 } },
+    { "rebuild, every period", proj::balancing::rebuild, { proj::rebalance_trigger::edits, period } },
+    { "rebuild, fibonacci", proj::balancing::rebuild, { proj::rebalance_trigger::fibonacci, 0 } },
+    { "join", proj::balancing::join, { proj::rebalance_trigger::never, 0 } },
+  };
+  for (const config& c : configs) {
+    rope copy = doc;
+    copy.setBalancingMode(c.mode);
+    copy.setRebalancePolicy(c.policy);
+    double ms = runEdits(copy, edits, gen);
+    proj::rebalance_stats stats = copy.rebalanceStats();
+    std::printf("%24s %12.3f %10s %12zu %14.3f\n", c.name, ms, copy.isBalanced() ? "yes" : "no",
+      stats.count, std::chrono::duration<double, std::milli>(stats.time).count());
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "proj/rope.hpp"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+namespace bench
+{
+  using proj::rope;
+  using std::string;
+
+  // Get the number of milliseconds taken to run the given function
+  template <typename F>
+  double timeMs(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+  }
+
+  // Generate (len) chars of printable text with a newline roughly every 80 chars
+  inline string makeText(size_t len, std::mt19937& gen) {
+    string text(len, ' ');
+    for (size_t i = 0; i < len; i++) {
+      size_t r = gen() % 80;
+      text[i] = (r == 0) ? '\n' : (r < 12) ? ' ' : static_cast<char>('a' + r % 26);
+    }
+    return text;
+  }
+
+  // Build a balanced rope of (len) chars split into leaves of (leafLen) chars
+  inline rope makeDocument(size_t len, size_t leafLen, std::mt19937& gen) {
+    std::vector<rope> level;
+    for (size_t i = 0; i < len; i += leafLen) {
+      level.push_back(rope(makeText(std::min(leafLen, len - i), gen)));
+    }
+    if (level.empty()) return rope();
+    // concatenate neighbouring ropes pairwise until a single rope remains
+    while (level.size() > 1) {
+      std::vector<rope> next;
+      for (size_t i = 0; i + 1 < level.size(); i += 2) {
+        next.push_back(level[i]);
+        next.back().append(level[i + 1]);
+      }
+      if (level.size() % 2 == 1) next.push_back(level.back());
+      level.swap(next);
+    }
+    return level[0];
+  }
+
+} // namespace bench
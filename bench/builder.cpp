@@ -0,0 +1,56 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Compare assembling a document from many small pieces with a rope_builder against
+//   appending the pieces to a rope and balancing it once at the end, and against
+//   appending them with a balance every 10^4 pieces
+//
+// usage: builder_bench [pieces]
+
+#include "bench.hpp"
+#include "proj/builder.hpp"
+#include <cstdlib>
+#include <vector>
+
+using namespace bench;
+
+int main(int argc, char * argv[]) {
+  size_t count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  std::mt19937 gen(1);
+  std::vector<string> pieces;
+  for (size_t i = 0; i < count; i++) pieces.push_back(makeText(1 + gen() % 32, gen));
+
+  rope appended;
+  double appendMs = timeMs([&] {
+    for (const string& p : pieces) appended.append(p);
+    appended.balance();
+  });
+
+  rope periodic;
+  double periodicMs = timeMs([&] {
+    for (size_t i = 0; i < count; i++) {
+      periodic.append(pieces[i]);
+      if (i % 10000 == 9999) periodic.balance();
+    }
+    periodic.balance();
+  });
+
+  proj::rope_builder builder;
+  rope built;
+  double buildMs = timeMs([&] {
+    for (const string& p : pieces) builder.append(p);
+    built = builder.build();
+  });
+
+  std::printf("pieces: %zu, document: %zu bytes\n", count, built.length());
+  std::printf("%24s %12s %10s\n", "method", "time (ms)", "balanced");
+  std::printf("%24s %12.3f %10s\n", "append+balance", appendMs, appended.isBalanced() ? "yes" : "no");
+  std::printf("%24s %12.3f %10s\n", "append+balance every 10^4", periodicMs, periodic.isBalanced() ? "yes" : "no");
+  std::printf("%24s %12.3f %10s\n", "rope_builder", buildMs, built.isBalanced() ? "yes" : "no");
+  if (appended != built || periodic != built) std::printf("documents differ\n");
+  return 0;
+}
@@ -0,0 +1,182 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Run identical operation mixes against proj::rope, std::string, __gnu_cxx::crope
+//   and the reference gap buffer and piece table in reference.hpp, printing for
+//   each mix a table of times by document size with the fastest structure, so that
+//   the sizes at which the rope overtakes the others can be read off
+//
+// usage: compare_bench [max bytes]
+//
+// Sizes run from 4 KiB up to the given maximum (16 MiB by default) in steps of 16x.
+//   The mixes, each applied to a fresh copy of the document, are:
+//     logging:  20000 appends of 64-byte lines
+//     editing:  2000 insertions and deletions of 1 to 8 chars at random positions
+//     scanning: 100000 reads of single chars at random positions
+//     slicing:  16 copies of slices of an eighth of the document
+// The rope uses join balancing, so that it stays balanced throughout every mix.
+
+#include "bench.hpp"
+#include "reference.hpp"
+#include "proj/builder.hpp"
+#include <cstdlib>
+#include <ext/rope>
+#include <vector>
+
+using namespace bench;
+
+// Written by every mix so that its reads are not optimized away
+static volatile size_t sink;
+
+// Adapt each structure to the operations of the reference buffers
+struct rope_doc {
+  explicit rope_doc(const string& str) : r(proj::rope_builder().append(str).build()) {
+    r.setBalancingMode(proj::balancing::join);
+  }
+  size_t length(void) const { return r.length(); }
+  char at(size_t i) const { return r.at(i); }
+  void append(const string& str) { r.append(str); }
+  void insert(size_t pos, const string& str) { r.insert(pos, str); }
+  void erase(size_t pos, size_t len) { r.rdelete(pos, len); }
+  void copy(size_t pos, size_t len, char * dst) const {
+    string s = r.substring(pos, len);
+    std::memcpy(dst, s.data(), len);
+  }
+  rope r;
+};
+
+struct string_doc {
+  explicit string_doc(const string& str) : s(str) {}
+  size_t length(void) const { return s.length(); }
+  char at(size_t i) const { return s[i]; }
+  void append(const string& str) { s.append(str); }
+  void insert(size_t pos, const string& str) { s.insert(pos, str); }
+  void erase(size_t pos, size_t len) { s.erase(pos, len); }
+  void copy(size_t pos, size_t len, char * dst) const { s.copy(dst, len, pos); }
+  string s;
+};
+
+struct crope_doc {
+  explicit crope_doc(const string& str) : c(str.data(), str.length()) {}
+  size_t length(void) const { return c.size(); }
+  char at(size_t i) const { return c[i]; }
+  void append(const string& str) { c.append(str.data(), str.length()); }
+  void insert(size_t pos, const string& str) { c.insert(pos, str.data(), str.length()); }
+  void erase(size_t pos, size_t len) { c.erase(pos, len); }
+  void copy(size_t pos, size_t len, char * dst) const { c.copy(pos, len, dst); }
+  __gnu_cxx::crope c;
+};
+
+template <typename Buffer>
+struct reference_doc {
+  explicit reference_doc(const string& str) : b(str) {}
+  size_t length(void) const { return b.length(); }
+  char at(size_t i) const { return b.at(i); }
+  void append(const string& str) { b.insert(b.length(), str.data(), str.length()); }
+  void insert(size_t pos, const string& str) { b.insert(pos, str.data(), str.length()); }
+  void erase(size_t pos, size_t len) { b.erase(pos, len); }
+  void copy(size_t pos, size_t len, char * dst) const { b.copy(pos, len, dst); }
+  Buffer b;
+};
+
+// Inputs shared by every structure, so that each runs exactly the same mix
+struct mix_inputs {
+  string text;
+  std::vector<string> lines;
+  std::vector<size_t> randoms;
+};
+
+// Time each mix on a fresh document of the given type
+template <typename Doc>
+static std::vector<double> runMixes(const mix_inputs& in) {
+  std::vector<double> times;
+  {
+    Doc doc(in.text);
+    times.push_back(timeMs([&] {
+      for (const string& line : in.lines) doc.append(line);
+    }));
+    sink = doc.length();
+  }
+  {
+    Doc doc(in.text);
+    times.push_back(timeMs([&] {
+      for (size_t i = 0; i < 2000; i++) {
+        size_t r = in.randoms[i];
+        size_t len = doc.length();
+        if (i % 2 == 0 || len < 8) {
+          doc.insert(r % (len + 1), in.lines[i].substr(0, 1 + r % 8));
+        } else {
+          doc.erase(r % (len - 8), 1 + r % 8);
+        }
+      }
+    }));
+    sink = doc.length();
+  }
+  {
+    Doc doc(in.text);
+    times.push_back(timeMs([&] {
+      size_t sum = 0;
+      for (size_t i = 0; i < 100000; i++) sum += doc.at(in.randoms[i] % in.text.length());
+      sink = sum;
+    }));
+  }
+  {
+    Doc doc(in.text);
+    size_t len = in.text.length() / 8;
+    std::vector<char> buffer(len);
+    times.push_back(timeMs([&] {
+      for (size_t i = 0; i < 16; i++) {
+        doc.copy(in.randoms[i] % (in.text.length() - len), len, buffer.data());
+        sink = buffer[len / 2];
+      }
+    }));
+  }
+  return times;
+}
+
+int main(int argc, char * argv[]) {
+  size_t maxBytes = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : (1 << 24);
+  std::mt19937 gen(1);
+  const char * mixes[] = { "logging", "editing", "scanning", "slicing" };
+  const char * names[] = { "proj::rope", "std::string", "crope", "gap_buffer", "piece_table" };
+  const size_t structures = 5;
+
+  // times[size][structure][mix]
+  std::vector<size_t> sizes;
+  std::vector<std::vector<std::vector<double>>> times;
+  for (size_t bytes = 4096; bytes <= maxBytes; bytes *= 16) {
+    mix_inputs in;
+    in.text = makeText(bytes, gen);
+    for (size_t i = 0; i < 20000; i++) in.lines.push_back(makeText(64, gen));
+    for (size_t i = 0; i < 100000; i++) in.randoms.push_back(gen());
+    sizes.push_back(bytes);
+    times.push_back({
+      runMixes<rope_doc>(in),
+      runMixes<string_doc>(in),
+      runMixes<crope_doc>(in),
+      runMixes<reference_doc<gap_buffer>>(in),
+      runMixes<reference_doc<piece_table>>(in)
+    });
+  }
+
+  for (size_t m = 0; m < 4; m++) {
+    std::printf("%s (ms)\n%10s", mixes[m], "bytes");
+    for (size_t s = 0; s < structures; s++) std::printf(" %12s", names[s]);
+    std::printf(" %12s\n", "fastest");
+    for (size_t i = 0; i < sizes.size(); i++) {
+      std::printf("%10zu", sizes[i]);
+      size_t best = 0;
+      for (size_t s = 0; s < structures; s++) {
+        std::printf(" %12.3f", times[i][s][m]);
+        if (times[i][s][m] < times[i][best][m]) best = s;
+      }
+      std::printf(" %12s\n", names[best]);
+    }
+    std::printf("\n");
+  }
+  return 0;
+}
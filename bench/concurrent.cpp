@@ -0,0 +1,93 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Compare read throughput of a shared_rope against a rope guarded by a mutex while
+//   one writer thread edits the document continuously
+//
+// usage: concurrent_bench [document bytes] [max readers] [ms per run]
+
+#include "bench.hpp"
+#include "proj/shared_rope.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace bench;
+
+// Run (readers) reader threads and one writer thread for (ms) milliseconds, using
+//   the given functions to read and edit, and return the number of reads per second
+template <typename Read, typename Edit>
+double readsPerSecond(size_t readers, size_t ms, Read read, Edit edit) {
+  std::atomic<bool> done(false);
+  std::atomic<size_t> reads(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < readers; t++) {
+    threads.push_back(std::thread([&, t] {
+      std::mt19937 gen(t + 1);
+      size_t count = 0;
+      char sink = 0;
+      while (!done.load(std::memory_order_relaxed)) {
+        sink ^= read(gen());
+        count++;
+      }
+      reads += count + (sink == 0x7f);
+    }));
+  }
+  threads.push_back(std::thread([&] {
+    std::mt19937 gen(0);
+    for (size_t i = 0; !done.load(std::memory_order_relaxed); i++) edit(gen(), i);
+  }));
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  done.store(true);
+  for (std::thread& t : threads) t.join();
+  return reads.load() * 1000.0 / ms;
+}
+
+int main(int argc, char * argv[]) {
+  size_t docLen = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : (1 << 22);
+  size_t maxReaders = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+  size_t ms = (argc > 3) ? std::strtoull(argv[3], nullptr, 10) : 500;
+  if (maxReaders == 0) maxReaders = 1;
+  std::mt19937 gen(1);
+  rope doc = makeDocument(docLen, 4096, gen);
+
+  std::printf("document: %zu bytes, %zu ms per run, 1 writer\n", docLen, ms);
+  std::printf("%8s %20s %20s\n", "readers", "shared_rope (r/s)", "mutex (r/s)");
+  for (size_t readers = 1; readers <= maxReaders; readers *= 2) {
+    // the writer inserts and removes a char, rebalancing periodically, so the
+    //   document keeps a constant length
+    proj::shared_rope shared(doc);
+    double sharedRate = readsPerSecond(readers, ms,
+      [&](size_t p) { return shared.read([&](const rope& r) { return r.at(p % docLen); }); },
+      [&](size_t p, size_t i) {
+        shared.update([&](rope& r) {
+          r.insert(p % docLen, "x");
+          r.rdelete(p % docLen, 1);
+          if (i % 1024 == 0) r.balance();
+        });
+      });
+
+    std::mutex lock;
+    rope guarded = doc;
+    double mutexRate = readsPerSecond(readers, ms,
+      [&](size_t p) {
+        std::lock_guard<std::mutex> hold(lock);
+        return guarded.at(p % docLen);
+      },
+      [&](size_t p, size_t i) {
+        std::lock_guard<std::mutex> hold(lock);
+        guarded.insert(p % docLen, "x");
+        guarded.rdelete(p % docLen, 1);
+        if (i % 1024 == 0) guarded.balance();
+      });
+
+    std::printf("%8zu %20.0f %20.0f\n", readers, sharedRate, mutexRate);
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Compare applying a batch of edits with rope::applyEdits against applying the
+//   same edits one at a time with rope::rdelete and rope::insert, and likewise
+//   rope::insertAtAll against repeated rope::insert
+//
+// usage: edits_bench [document bytes]
+//
+// Edits applied one at a time deepen the tree along every edited path, so the
+//   one-by-one column is only measured for batches of up to 4096 edits.
+
+#include "bench.hpp"
+#include <cstdlib>
+#include <vector>
+
+using namespace bench;
+
+// Generate (count) sorted, non-overlapping edits spread evenly over (len) chars
+static std::vector<rope::edit> makeEdits(size_t count, size_t len, std::mt19937& gen) {
+  std::vector<rope::edit> edits;
+  size_t stride = len / count;
+  for (size_t i = 0; i < count; i++) {
+    size_t deleteLen = gen() % std::min<size_t>(stride, 8);
+    size_t offset = i * stride + gen() % (stride - deleteLen);
+    edits.push_back({offset, deleteLen, makeText(gen() % 8, gen)});
+  }
+  return edits;
+}
+
+int main(int argc, char * argv[]) {
+  size_t docLen = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : (1 << 22);
+  std::mt19937 gen(1);
+  rope doc = makeDocument(docLen, 4096, gen);
+
+  std::printf("%10s %14s %15s %15s\n", "edits", "batched (ms)", "one-by-one (ms)", "ns/edit (batch)");
+  for (size_t count = 16; count <= docLen / 16 && count <= (1 << 16); count *= 4) {
+    std::vector<rope::edit> edits = makeEdits(count, docLen, gen);
+
+    rope batched = doc;
+    double batchMs = timeMs([&] { batched.applyEdits(edits); });
+
+    if (count > 4096) {
+      std::printf("%10zu %14.3f %15s %15.1f\n", count, batchMs, "-", batchMs * 1e6 / count);
+      continue;
+    }
+
+    rope serial = doc;
+    double serialMs = timeMs([&] {
+      // apply from last to first so that earlier offsets remain valid
+      for (auto e = edits.rbegin(); e != edits.rend(); e++) {
+        serial.rdelete(e->offset, e->deleteLen);
+        serial.insert(e->offset, e->insertText);
+      }
+    });
+
+    if (batched != serial) {
+      std::fprintf(stderr, "mismatch after %zu edits\n", count);
+      return 1;
+    }
+    std::printf("%10zu %14.3f %15.3f %15.1f\n", count, batchMs, serialMs, batchMs * 1e6 / count);
+  }
+
+  std::printf("\n%10s %14s %15s %15s\n", "cursors", "batched (ms)", "one-by-one (ms)", "ns/cursor (batch)");
+  for (size_t count = 16; count <= docLen / 16 && count <= (1 << 16); count *= 4) {
+    std::vector<size_t> positions;
+    for (size_t i = 0; i < count; i++) positions.push_back(i * (docLen / count));
+
+    rope batched = doc;
+    double batchMs = timeMs([&] { batched.insertAtAll(positions, "// "); });
+
+    if (count > 4096) {
+      std::printf("%10zu %14.3f %15s %15.1f\n", count, batchMs, "-", batchMs * 1e6 / count);
+      continue;
+    }
+
+    rope serial = doc;
+    double serialMs = timeMs([&] {
+      for (auto p = positions.rbegin(); p != positions.rend(); p++) serial.insert(*p, "// ");
+    });
+
+    if (batched != serial) {
+      std::fprintf(stderr, "mismatch after %zu insertions\n", count);
+      return 1;
+    }
+    std::printf("%10zu %14.3f %15.3f %15.1f\n", count, batchMs, serialMs, batchMs * 1e6 / count);
+  }
+  return 0;
+}
@@ -0,0 +1,38 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Measure the throughput of flattening a rope into a contiguous buffer with
+//   toString and with copyToParallel on an increasing number of threads
+//
+// usage: flatten_bench [document bytes] [max threads]
+
+#include "bench.hpp"
+#include <cstdlib>
+#include <vector>
+
+using namespace bench;
+
+int main(int argc, char * argv[]) {
+  size_t docLen = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : (1 << 28);
+  size_t maxThreads = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 32;
+  std::mt19937 gen(1);
+  rope doc = makeDocument(docLen, 4096, gen);
+  std::vector<char> buffer(docLen);
+  // touch every page so the first run does not pay for page faults
+  doc.copyTo(buffer.data());
+
+  std::printf("document: %zu bytes\n", docLen);
+  std::printf("%12s %12s %12s\n", "threads", "time (ms)", "GB/s");
+  double serialMs = timeMs([&] { string s = doc.toString(); });
+  std::printf("%12s %12.3f %12.3f\n", "toString", serialMs, docLen / serialMs / 1e6);
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+    proj::task_pool pool(threads);
+    double ms = timeMs([&] { doc.copyToParallel(buffer.data(), pool); });
+    std::printf("%12zu %12.3f %12.3f\n", threads, ms, docLen / ms / 1e6);
+  }
+  return 0;
+}
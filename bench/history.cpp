@@ -0,0 +1,67 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Compare recording versions in a rope_history against an undo stack holding a
+//   full copy of the document per version
+//
+// usage: history_bench [document bytes] [edits]
+
+#include "bench.hpp"
+#include "proj/history.hpp"
+#include <cstdlib>
+#include <vector>
+
+using namespace bench;
+
+int main(int argc, char * argv[]) {
+  size_t docLen = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : (1 << 22);
+  size_t edits = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 1000;
+  std::mt19937 gen(1);
+  rope doc = makeDocument(docLen, 4096, gen);
+
+  // generate the edits up front so both histories see the same sequence
+  std::vector<size_t> positions;
+  for (size_t i = 0; i < edits; i++) positions.push_back(gen() % docLen);
+
+  // structurally shared history
+  proj::rope_history history = proj::rope_history(doc);
+  rope shared = doc;
+  double sharedMs = timeMs([&] {
+    for (size_t p : positions) {
+      shared.insert(p, "x");
+      history.commit(shared);
+    }
+  });
+  double sharedUndoMs = timeMs([&] {
+    while (history.canUndo()) history.undo();
+  });
+
+  // stack of full copies
+  std::vector<string> stack;
+  stack.push_back(doc.toString());
+  rope copied = doc;
+  double copiedMs = timeMs([&] {
+    for (size_t p : positions) {
+      copied.insert(p, "x");
+      stack.push_back(copied.toString());
+    }
+  });
+  size_t copiedBytes = 0;
+  for (size_t i = 1; i < stack.size(); i++) copiedBytes += stack[i].capacity();
+  double copiedUndoMs = timeMs([&] {
+    while (stack.size() > 1) {
+      stack.pop_back();
+      copied = rope(stack.back());
+    }
+  });
+
+  std::printf("document: %zu bytes, versions: %zu\n", docLen, edits);
+  std::printf("%14s %14s %14s %18s\n", "history", "record (ms)", "undo all (ms)", "retained (bytes)");
+  std::printf("%14s %14.3f %14.3f %18zu\n", "rope_history", sharedMs, sharedUndoMs, history.memoryUsage());
+  std::printf("%14s %14.3f %14.3f %18zu\n", "full copies", copiedMs, copiedUndoMs, copiedBytes);
+  return 0;
+}
@@ -0,0 +1,64 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Measure the cost of recording a latency, and report the latency histograms of
+//   rope operations if the library was built with PROJ_LATENCY_HISTOGRAMS
+//
+// usage: latency_bench [operations]
+
+#include "bench.hpp"
+#include "proj/latency.hpp"
+#include <cstdlib>
+
+using namespace bench;
+
+int main(int argc, char * argv[]) {
+  size_t count = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  std::mt19937 gen(1);
+
+  // the cost of an empty timed scope is the whole overhead of instrumenting an op,
+  //   both when sampling and when timing every op
+  size_t period = proj::latencySamplePeriod();
+  double sampledMs = timeMs([&] {
+    for (size_t i = 0; i < count; i++) proj::latency_timer t(proj::rope_op::substring);
+  });
+  proj::setLatencySamplePeriod(1);
+  double timerMs = timeMs([&] {
+    for (size_t i = 0; i < count; i++) proj::latency_timer t(proj::rope_op::substring);
+  });
+  proj::setLatencySamplePeriod(period);
+  double recordMs = timeMs([&] {
+    for (size_t i = 0; i < count; i++) proj::recordLatency(proj::rope_op::substring, i & 1023);
+  });
+  std::printf("overhead per op: %.2f ns timed scope sampling 1 in %zu, %.2f ns timing every op, "
+    "%.2f ns recording alone\n", sampledMs * 1e6 / count, period, timerMs * 1e6 / count,
+    recordMs * 1e6 / count);
+
+#ifdef PROJ_LATENCY_HISTOGRAMS
+  proj::resetLatencies();
+  rope doc = makeDocument(1 << 22, 1024, gen);
+  doc.setRebalancePolicy({ proj::rebalance_trigger::fibonacci, 0 });
+  for (size_t i = 0; i < count / 10; i++) {
+    size_t pos = gen() % (doc.length() - 64);
+    if (i % 4 == 0) doc.insert(pos, "inserted");
+    else if (i % 4 == 1) doc.rdelete(pos, 8);
+    else doc.substring(pos, 64);
+  }
+  const char * names[] = { "insert", "rdelete", "substring", "balance" };
+  std::printf("%10s %10s %10s %10s %10s\n", "operation", "count", "p50 (ns)", "p99 (ns)", "p99.9 (ns)");
+  for (size_t op = 0; op < proj::ROPE_OP_COUNT; op++) {
+    proj::latency_histogram h = proj::latencySnapshot(static_cast<proj::rope_op>(op));
+    std::printf("%10s %10llu %10llu %10llu %10llu\n", names[op], (unsigned long long) h.count(),
+      (unsigned long long) h.percentile(0.5), (unsigned long long) h.percentile(0.99),
+      (unsigned long long) h.percentile(0.999));
+  }
+#else
+  (void) gen;
+  std::printf("configure with -DPROJ_LATENCY_HISTOGRAMS=ON to record rope operations\n");
+#endif
+  return 0;
+}
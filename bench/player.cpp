@@ -0,0 +1,109 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Replay a recording made with proj::recording_rope (src/proj/recorder.hpp) as
+//   fast as possible, reporting the total time and the median and 99th percentile
+//   latency of each kind of operation, and a hash of the final document, so that
+//   runs against two builds of the rope can be compared
+//
+// usage: player_bench <recording>
+//        player_bench --synthesize <recording> [operations] [redact]
+//
+// The second form writes a recording of a random workload (mostly reads and small
+//   edits of a 1 MiB document), for trying out the player without a real one.
+
+#include "bench.hpp"
+#include "proj/recorder.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+using namespace bench;
+
+// Written by every read so that it is not optimized away
+static volatile size_t sink;
+
+// Write a recording of a random workload to the given file
+static int synthesize(const char * path, size_t count, bool redact) {
+  std::ofstream out(path, std::ios::binary);
+  if (!out) {
+    std::fprintf(stderr, "cannot write %s\n", path);
+    return 1;
+  }
+  std::mt19937 gen(1);
+  string initial = makeText(1 << 20, gen);
+  proj::op_recorder recorder(out, initial, redact);
+  proj::recording_rope doc(rope(initial), recorder);
+  for (size_t i = 0; i < count; i++) {
+    size_t len = doc.length();
+    size_t r = gen() % 100;
+    size_t pos = gen() % (len - 64);
+    if (r < 40) sink = doc.at(pos);
+    else if (r < 60) sink = doc.substring(pos, 64).length();
+    else if (r < 80) doc.insert(pos, makeText(1 + gen() % 8, gen));
+    else if (r < 95) doc.rdelete(pos, 1 + gen() % 8);
+    else doc.append(makeText(80, gen));
+  }
+  return out ? 0 : 1;
+}
+
+int main(int argc, char * argv[]) {
+  if (argc > 2 && std::strcmp(argv[1], "--synthesize") == 0) {
+    size_t count = (argc > 3) ? std::strtoull(argv[3], nullptr, 10) : 100000;
+    return synthesize(argv[2], count, argc > 4 && std::strcmp(argv[4], "redact") == 0);
+  }
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: player_bench <recording>\n");
+    return 1;
+  }
+
+  // read the whole recording first, so that reading it is not timed
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in) {
+    std::fprintf(stderr, "cannot read %s\n", argv[1]);
+    return 1;
+  }
+  std::vector<proj::recorded_op> ops;
+  rope doc;
+  try {
+    proj::op_reader reader(in);
+    doc = rope(reader.initial());
+    proj::recorded_op op;
+    while (reader.next(op)) ops.push_back(op);
+  } catch (const std::invalid_argument& e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  const char * names[] = { "insert", "append", "rdelete", "substring", "at" };
+  std::vector<double> latencies[5];
+  double totalMs = timeMs([&] {
+    for (const proj::recorded_op& op : ops) {
+      auto before = std::chrono::steady_clock::now();
+      sink = proj::playOp(doc, op);
+      latencies[static_cast<size_t>(op.kind)].push_back(
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count());
+    }
+  });
+
+  std::printf("%zu operations in %.3f ms (recorded over %.3f ms)\n", ops.size(), totalMs,
+    ops.empty() ? 0.0 : ops.back().timeNs / 1e6);
+  std::printf("%10s %10s %10s %10s\n", "operation", "count", "p50 (ns)", "p99 (ns)");
+  for (size_t k = 0; k < 5; k++) {
+    std::vector<double>& l = latencies[k];
+    if (l.empty()) continue;
+    std::sort(l.begin(), l.end());
+    std::printf("%10s %10zu %10.0f %10.0f\n", names[k], l.size(), l[l.size() / 2], l[l.size() * 99 / 100]);
+  }
+  string s = doc.toString();
+  size_t h = 14695981039346656037ull;
+  for (char c : s) h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  std::printf("final document: %zu bytes, depth %zu, hash %016zx\n", s.length(), doc.depth(), h);
+  return 0;
+}
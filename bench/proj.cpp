@@ -0,0 +1,146 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Time every rope operation across document sizes and tree shapes, printing one
+//   record per (operation, shape, size) as CSV or JSON for tracking regressions
+//
+// Each record also gives the mean number of allocations and of bytes allocated
+//   per operation, counted by linking proj_alloc_count.
+//
+// usage: proj_bench [max bytes] [csv|json]
+//
+// Sizes run from 1 KiB up to the given maximum (64 MiB by default, 1 GiB at most)
+//   in steps of 16x. The shapes are:
+//     balanced: built with a rope_builder from leaves of 1 KiB
+//     chain:    up to 4096 pieces appended one at a time, so unbalanced
+//     edited:   a balanced rope after one small random insertion per 256 bytes
+//               (up to 10^4 insertions), so with many short leaves on deep paths
+// Each mutating operation is applied to a fresh copy of the document, which shares
+//   its tree in O(1) time, so that every iteration sees the same shape.
+
+#include "bench.hpp"
+#include "proj/alloc_count.hpp"
+#include "proj/builder.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace bench;
+
+// Result of timing a single operation on a single document
+struct record {
+  const char * operation;
+  const char * shape;
+  size_t bytes;
+  size_t iterations;
+  double nsPerOp;
+  double allocsPerOp;
+  double bytesPerOp;
+};
+
+// Result of measuring an operation
+struct measurement {
+  size_t iterations;
+  double nsPerOp;
+  double allocsPerOp;
+  double bytesPerOp;
+};
+
+// Written by every timed operation so that its result is not optimized away
+static volatile size_t sink;
+
+// Run f(i) for increasing i until at least 20 ms have passed or 10^6 iterations
+//   have run, and get the number of iterations and the mean time and allocations
+//   per iteration
+template <typename F>
+static measurement measure(F f) {
+  size_t iterations = 0;
+  double ms = 0;
+  proj::alloc_scope scope;
+  for (size_t batch = 1; ms < 20 && iterations < 1000000; batch *= 2) {
+    ms += timeMs([&] {
+      for (size_t i = 0; i < batch; i++) f(iterations + i);
+    });
+    iterations += batch;
+  }
+  proj::alloc_counts counts = scope.counts();
+  return measurement{ iterations, ms * 1e6 / iterations,
+    double(counts.allocations) / iterations, double(counts.bytes) / iterations };
+}
+
+// Build a document of the given shape holding the given text
+static rope makeShape(const string& shape, const string& text, std::mt19937& gen) {
+  if (shape == "chain") {
+    size_t piece = std::max<size_t>(1024, text.length() / 4096);
+    rope doc = rope(text.substr(0, std::min(piece, text.length())));
+    for (size_t i = piece; i < text.length(); i += piece) doc.append(text.substr(i, piece));
+    return doc;
+  }
+  proj::rope_builder builder;
+  rope doc = builder.append(text).build();
+  if (shape == "edited") {
+    size_t edits = std::min<size_t>(10000, text.length() / 256);
+    for (size_t i = 0; i < edits; i++) doc.insert(gen() % doc.length(), makeText(1 + gen() % 8, gen));
+  }
+  return doc;
+}
+
+int main(int argc, char * argv[]) {
+  size_t maxBytes = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : (1 << 26);
+  bool json = (argc > 2) && std::strcmp(argv[2], "json") == 0;
+  maxBytes = std::min<size_t>(maxBytes, size_t(1) << 30);
+  std::mt19937 gen(1);
+  std::vector<record> records;
+  const char * shapes[] = { "balanced", "chain", "edited" };
+
+  for (size_t bytes = 1024; bytes <= maxBytes; bytes *= 16) {
+    string text = makeText(bytes, gen);
+    // the document is read by value in every shape, so construction is shape-free
+    measurement build = measure([&](size_t) { sink = rope(text).length(); });
+    records.push_back({ "construct", "leaf", bytes, build.iterations, build.nsPerOp, build.allocsPerOp, build.bytesPerOp });
+
+    for (const char * shape : shapes) {
+      rope doc = makeShape(shape, text, gen);
+      size_t len = doc.length();
+      // precompute positions, so that generating them is not timed
+      std::vector<size_t> positions(4096);
+      for (size_t& p : positions) p = gen() % (len - 64);
+      auto pos = [&](size_t i) { return positions[i % positions.size()]; };
+
+      auto add = [&](const char * operation, measurement m) {
+        records.push_back({ operation, shape, len, m.iterations, m.nsPerOp, m.allocsPerOp, m.bytesPerOp });
+      };
+      add("at", measure([&](size_t i) { sink = doc.at(pos(i)); }));
+      add("substring", measure([&](size_t i) { sink = doc.substring(pos(i), 64).length(); }));
+      add("insert", measure([&](size_t i) { rope r = doc; r.insert(pos(i), "inserted"); sink = r.length(); }));
+      add("append", measure([&](size_t) { rope r = doc; r.append("appended"); sink = r.length(); }));
+      add("rdelete", measure([&](size_t i) { rope r = doc; r.rdelete(pos(i), 8); sink = r.length(); }));
+      add("balance", measure([&](size_t) { rope r = doc; r.balance(); sink = r.length(); }));
+      add("toString", measure([&](size_t) { sink = doc.toString().length(); }));
+      add("copy", measure([&](size_t) { rope r = doc; sink = r.length(); }));
+    }
+  }
+
+  if (json) {
+    std::printf("[\n");
+    for (size_t i = 0; i < records.size(); i++) {
+      const record& r = records[i];
+      std::printf("  {\"operation\": \"%s\", \"shape\": \"%s\", \"bytes\": %zu, \"iterations\": %zu, "
+        "\"ns_per_op\": %.1f, \"allocs_per_op\": %.2f, \"bytes_allocated_per_op\": %.1f}%s\n",
+        r.operation, r.shape, r.bytes, r.iterations, r.nsPerOp, r.allocsPerOp, r.bytesPerOp,
+        (i + 1 < records.size()) ? "," : "");
+    }
+    std::printf("]\n");
+  } else {
+    std::printf("operation,shape,bytes,iterations,ns_per_op,allocs_per_op,bytes_allocated_per_op\n");
+    for (const record& r : records) {
+      std::printf("%s,%s,%zu,%zu,%.1f,%.2f,%.1f\n", r.operation, r.shape, r.bytes, r.iterations,
+        r.nsPerOp, r.allocsPerOp, r.bytesPerOp);
+    }
+  }
+  return 0;
+}
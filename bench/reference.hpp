@@ -0,0 +1,181 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace bench
+{
+  using std::string;
+
+  // Reference text buffers which the rope is benchmarked against. Each supports
+  //   the same operations: length, at, insert, erase and copy (of a slice to a
+  //   buffer), with positions which the caller guarantees to be in range.
+
+  // A gap buffer holds the text in a single array with a gap at the most recent
+  //   edit, so that edits near one another move only the chars between them
+  class gap_buffer {
+
+  public:
+
+    explicit gap_buffer(const string& str)
+      : buf_(str.begin(), str.end()), gapStart_(str.length()), gapEnd_(str.length())
+    {}
+
+    size_t length(void) const { return this->buf_.size() - (this->gapEnd_ - this->gapStart_); }
+
+    char at(size_t i) const {
+      return (i < this->gapStart_) ? this->buf_[i] : this->buf_[i + this->gapEnd_ - this->gapStart_];
+    }
+
+    void insert(size_t pos, const char * str, size_t len) {
+      if (this->gapEnd_ - this->gapStart_ < len) this->grow(len);
+      this->moveGap(pos);
+      std::memcpy(&this->buf_[this->gapStart_], str, len);
+      this->gapStart_ += len;
+    }
+
+    void erase(size_t pos, size_t len) {
+      this->moveGap(pos);
+      this->gapEnd_ += len;
+    }
+
+    void copy(size_t pos, size_t len, char * dst) const {
+      // copy the part of the slice before the gap, then the part after it
+      size_t before = (pos < this->gapStart_) ? std::min(len, this->gapStart_ - pos) : 0;
+      if (before > 0) std::memcpy(dst, &this->buf_[pos], before);
+      if (len > before) {
+        std::memcpy(dst + before, &this->buf_[pos + before + this->gapEnd_ - this->gapStart_], len - before);
+      }
+    }
+
+  private:
+
+    // Move the gap so that it begins at the given position
+    void moveGap(size_t pos) {
+      if (pos < this->gapStart_) {
+        size_t n = this->gapStart_ - pos;
+        std::memmove(&this->buf_[this->gapEnd_ - n], &this->buf_[pos], n);
+        this->gapStart_ -= n;
+        this->gapEnd_ -= n;
+      } else if (pos > this->gapStart_) {
+        size_t n = pos - this->gapStart_;
+        std::memmove(&this->buf_[this->gapStart_], &this->buf_[this->gapEnd_], n);
+        this->gapStart_ += n;
+        this->gapEnd_ += n;
+      }
+    }
+
+    // Widen the gap to hold at least (len) chars, doubling the buffer
+    void grow(size_t len) {
+      size_t after = this->buf_.size() - this->gapEnd_;
+      size_t size = std::max(this->buf_.size() * 2, this->buf_.size() + len);
+      this->buf_.resize(size);
+      std::memmove(&this->buf_[size - after], &this->buf_[this->gapEnd_], after);
+      this->gapEnd_ = size - after;
+    }
+
+    std::vector<char> buf_;
+    size_t gapStart_;
+    size_t gapEnd_;
+
+  }; // class gap_buffer
+
+  // A piece table holds the original text and an append-only buffer of inserted
+  //   text, and describes the document as a sequence of pieces of either. Pieces
+  //   are located by a linear scan, as in the simplest piece tables.
+  class piece_table {
+
+  public:
+
+    explicit piece_table(const string& str) : original_(str), length_(str.length()) {
+      if (!str.empty()) this->pieces_.push_back({ false, 0, str.length() });
+    }
+
+    size_t length(void) const { return this->length_; }
+
+    char at(size_t i) const {
+      for (const piece& p : this->pieces_) {
+        if (i < p.len) return this->text(p)[p.start + i];
+        i -= p.len;
+      }
+      return '\0';
+    }
+
+    void insert(size_t pos, const char * str, size_t len) {
+      size_t index = this->splitAt(pos);
+      this->pieces_.insert(this->pieces_.begin() + index, piece{ true, this->added_.length(), len });
+      this->added_.append(str, len);
+      this->length_ += len;
+    }
+
+    void erase(size_t pos, size_t len) {
+      size_t first = this->splitAt(pos);
+      size_t last = this->splitAt(pos + len);
+      this->pieces_.erase(this->pieces_.begin() + first, this->pieces_.begin() + last);
+      this->length_ -= len;
+    }
+
+    void copy(size_t pos, size_t len, char * dst) const {
+      for (const piece& p : this->pieces_) {
+        if (len == 0) break;
+        if (pos >= p.len) {
+          pos -= p.len;
+          continue;
+        }
+        size_t n = std::min(len, p.len - pos);
+        std::memcpy(dst, this->text(p) + p.start + pos, n);
+        dst += n;
+        len -= n;
+        pos = 0;
+      }
+    }
+
+  private:
+
+    struct piece {
+      bool added;
+      size_t start;
+      size_t len;
+    };
+
+    const char * text(const piece& p) const {
+      return p.added ? this->added_.data() : this->original_.data();
+    }
+
+    // Split the piece containing the given position, so that a piece begins there,
+    //   and get the index of that piece
+    size_t splitAt(size_t pos) {
+      // appending is common enough to spare it the scan
+      if (pos == this->length_) return this->pieces_.size();
+      size_t i = 0;
+      for (; i < this->pieces_.size(); i++) {
+        piece& p = this->pieces_[i];
+        if (pos == 0) return i;
+        if (pos < p.len) {
+          piece rest = { p.added, p.start + pos, p.len - pos };
+          p.len = pos;
+          this->pieces_.insert(this->pieces_.begin() + i + 1, rest);
+          return i + 1;
+        }
+        pos -= p.len;
+      }
+      return i;
+    }
+
+    string original_;
+    string added_;
+    std::vector<piece> pieces_;
+    size_t length_;
+
+  }; // class piece_table
+
+} // namespace bench
@@ -0,0 +1,259 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Replay an editing trace against proj::rope, std::string and __gnu_cxx::crope,
+//   reporting the total time, the median and 99th percentile latency of a single
+//   edit, the peak resident memory and the final depth of the tree
+//
+// usage: replay_bench <trace file>
+//
+// A trace holds one edit per line, as "<position> <delete count> <insert text>",
+//   where the insert text is a JSON string literal and positions are byte offsets
+//   into the document as it is before the edit. Published traces such as those at
+//   https://github.com/josephg/editing-traces can be converted with
+//
+//     jq -r '.txns[].patches[] | "\(.[0]) \(.[1]) \(.[2] | @json)"' trace.json
+//
+//   which counts positions in code points, so that they are byte offsets only for
+//   traces of ASCII text.
+//
+// Each structure replays the trace in a child process, so that the peak resident
+//   memory of each is measured separately; it includes the trace itself, whose
+//   size is reported alongside.
+
+#include "bench.hpp"
+#include <algorithm>
+#include <ext/rope>
+#include <fstream>
+#include <functional>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace bench;
+
+struct trace_edit {
+  size_t pos;
+  size_t deleteLen;
+  string text;
+};
+
+// Result of replaying the trace against one structure, passed back to the parent
+struct replay_result {
+  double totalMs;
+  double p50Ns;
+  double p99Ns;
+  size_t depth;
+  size_t length;
+  size_t hash;
+};
+
+// Append the UTF-8 encoding of the given code point to the string
+static void appendUtf8(string& out, unsigned long cp) {
+  if (cp < 0x80) {
+    out += static_cast<char>(cp);
+  } else if (cp < 0x800) {
+    out += static_cast<char>(0xC0 | (cp >> 6));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else if (cp < 0x10000) {
+    out += static_cast<char>(0xE0 | (cp >> 12));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (cp >> 18));
+    out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (cp & 0x3F));
+  }
+}
+
+// Decode the JSON string literal beginning at index (i) of the given line
+static bool parseJsonString(const string& line, size_t i, string& out) {
+  if (i >= line.length() || line[i] != '"') return false;
+  for (i++; i < line.length() && line[i] != '"'; i++) {
+    if (line[i] != '\\') {
+      out += line[i];
+      continue;
+    }
+    if (++i >= line.length()) return false;
+    switch (line[i]) {
+      case 'n': out += '\n'; break;
+      case 't': out += '\t'; break;
+      case 'r': out += '\r'; break;
+      case 'b': out += '\b'; break;
+      case 'f': out += '\f'; break;
+      case 'u': {
+        if (i + 4 >= line.length()) return false;
+        unsigned long cp = std::stoul(line.substr(i + 1, 4), nullptr, 16);
+        i += 4;
+        // combine a surrogate pair into a single code point
+        if (cp >= 0xD800 && cp < 0xDC00 && i + 6 < line.length() && line[i + 1] == '\\') {
+          unsigned long low = std::stoul(line.substr(i + 3, 4), nullptr, 16);
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+          i += 6;
+        }
+        appendUtf8(out, cp);
+        break;
+      }
+      default: out += line[i];
+    }
+  }
+  return i < line.length();
+}
+
+// Read the trace in the given file, stopping at the first malformed line
+static std::vector<trace_edit> readTrace(const char * path) {
+  std::vector<trace_edit> trace;
+  std::ifstream in(path);
+  string line;
+  while (std::getline(in, line)) {
+    trace_edit e;
+    size_t first = line.find(' ');
+    size_t second = line.find(' ', first + 1);
+    if (first == string::npos || second == string::npos) break;
+    e.pos = std::strtoull(line.c_str(), nullptr, 10);
+    e.deleteLen = std::strtoull(line.c_str() + first + 1, nullptr, 10);
+    if (!parseJsonString(line, second + 1, e.text)) break;
+    trace.push_back(std::move(e));
+  }
+  return trace;
+}
+
+// Exposes the depth of the tree of a crope
+struct depth_crope : __gnu_cxx::crope {
+  size_t depth(void) const { return (_M_tree_ptr == nullptr) ? 0 : _M_tree_ptr->_M_depth; }
+};
+
+// Hash the chars of a document, so that the final documents can be compared
+template <typename It>
+static size_t hashChars(It begin, It end) {
+  size_t h = 14695981039346656037ull;
+  for (It i = begin; i != end; ++i) h = (h ^ static_cast<unsigned char>(*i)) * 1099511628211ull;
+  return h;
+}
+
+// Replay the trace, applying each edit with apply(doc, edit) and timing it
+template <typename Doc, typename Apply>
+static replay_result replay(Doc& doc, const std::vector<trace_edit>& trace, Apply apply) {
+  std::vector<double> latencies(trace.size());
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < trace.size(); i++) {
+    auto before = std::chrono::steady_clock::now();
+    apply(doc, trace[i]);
+    latencies[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count();
+  }
+  double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  std::sort(latencies.begin(), latencies.end());
+  replay_result result = {};
+  result.totalMs = totalMs;
+  if (!latencies.empty()) {
+    result.p50Ns = latencies[latencies.size() / 2];
+    result.p99Ns = latencies[latencies.size() * 99 / 100];
+  }
+  return result;
+}
+
+// Run the given function in a child process, getting its result and peak memory
+template <typename F>
+static bool runChild(F f, replay_result& result, long& maxRssKb) {
+  int fds[2];
+  if (pipe(fds) != 0) return false;
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    replay_result r = f();
+    ssize_t written = write(fds[1], &r, sizeof(r));
+    _exit(written == sizeof(r) ? 0 : 1);
+  }
+  close(fds[1]);
+  ssize_t got = read(fds[0], &result, sizeof(result));
+  close(fds[0]);
+  int status = 0;
+  struct rusage usage;
+  if (pid < 0 || wait4(pid, &status, 0, &usage) != pid) return false;
+  maxRssKb = usage.ru_maxrss;
+  return got == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char * argv[]) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: replay_bench <trace file>\n");
+    return 1;
+  }
+  std::vector<trace_edit> trace = readTrace(argv[1]);
+  size_t traceBytes = 0;
+  for (const trace_edit& e : trace) traceBytes += sizeof(e) + e.text.capacity();
+  std::printf("trace: %zu edits, %zu KiB in memory\n", trace.size(), traceBytes / 1024);
+
+  struct structure {
+    const char * name;
+    std::function<replay_result(void)> run;
+  };
+  // reject edits which do not fit the document, so that a bad trace cannot crash
+  //   one structure and not another
+  std::vector<structure> structures = {
+    { "rope (fibonacci)", [&] {
+      rope doc;
+      doc.setRebalancePolicy({ proj::rebalance_trigger::fibonacci, 0 });
+      replay_result r = replay(doc, trace, [](rope& d, const trace_edit& e) {
+        if (e.pos + e.deleteLen > d.length()) return;
+        if (e.deleteLen > 0) d.rdelete(e.pos, e.deleteLen);
+        if (!e.text.empty()) d.insert(e.pos, e.text);
+      });
+      string s = doc.toString();
+      r.depth = doc.depth(), r.length = s.length(), r.hash = hashChars(s.begin(), s.end());
+      return r;
+    } },
+    { "rope (join)", [&] {
+      rope doc;
+      doc.setBalancingMode(proj::balancing::join);
+      replay_result r = replay(doc, trace, [](rope& d, const trace_edit& e) {
+        if (e.pos + e.deleteLen > d.length()) return;
+        if (e.deleteLen > 0) d.rdelete(e.pos, e.deleteLen);
+        if (!e.text.empty()) d.insert(e.pos, e.text);
+      });
+      string s = doc.toString();
+      r.depth = doc.depth(), r.length = s.length(), r.hash = hashChars(s.begin(), s.end());
+      return r;
+    } },
+    { "std::string", [&] {
+      string doc;
+      replay_result r = replay(doc, trace, [](string& d, const trace_edit& e) {
+        if (e.pos + e.deleteLen > d.length()) return;
+        d.replace(e.pos, e.deleteLen, e.text);
+      });
+      r.depth = 0, r.length = doc.length(), r.hash = hashChars(doc.begin(), doc.end());
+      return r;
+    } },
+    { "__gnu_cxx::crope", [&] {
+      depth_crope doc;
+      replay_result r = replay(doc, trace, [](depth_crope& d, const trace_edit& e) {
+        if (e.pos + e.deleteLen > d.size()) return;
+        d.replace(e.pos, e.deleteLen, e.text.data(), e.text.size());
+      });
+      r.depth = doc.depth(), r.length = doc.size(), r.hash = hashChars(doc.begin(), doc.end());
+      return r;
+    } },
+  };
+
+  std::printf("%18s %12s %10s %10s %14s %8s\n", "structure", "total (ms)", "p50 (ns)", "p99 (ns)", "peak RSS (KiB)", "depth");
+  size_t expectedHash = 0;
+  for (size_t i = 0; i < structures.size(); i++) {
+    replay_result r;
+    long maxRssKb = 0;
+    if (!runChild(structures[i].run, r, maxRssKb)) {
+      std::printf("%18s failed\n", structures[i].name);
+      continue;
+    }
+    std::printf("%18s %12.3f %10.0f %10.0f %14ld %8zu\n", structures[i].name,
+      r.totalMs, r.p50Ns, r.p99Ns, maxRssKb, r.depth);
+    if (i == 0) expectedHash = r.hash;
+    else if (r.hash != expectedHash) std::printf("%18s final document differs\n", structures[i].name);
+  }
+  return 0;
+}
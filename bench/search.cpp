@@ -0,0 +1,41 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Compare find against findParallel and countParallel on an increasing number of
+//   threads, searching a document for a needle which occurs once near its end
+//
+// usage: search_bench [document bytes] [max threads]
+
+#include "bench.hpp"
+#include <cstdlib>
+
+using namespace bench;
+
+int main(int argc, char * argv[]) {
+  size_t docLen = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : (1 << 28);
+  size_t maxThreads = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 32;
+  std::mt19937 gen(1);
+  rope doc = makeDocument(docLen, 4096, gen);
+  // makeText never produces digits, so the needle occurs exactly once
+  string needle = "0123456789";
+  doc.insert(docLen - docLen / 16, needle);
+
+  std::printf("document: %zu bytes\n", doc.length());
+  std::printf("%10s %16s %16s %16s\n", "threads", "find (ms)", "count (ms)", "find (GB/s)");
+  size_t found = 0;
+  double serialMs = timeMs([&] { found = doc.find(needle); });
+  std::printf("%10s %16.3f %16s %16.3f\n", "serial", serialMs, "-", found / serialMs / 1e6);
+  for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+    proj::task_pool pool(threads);
+    size_t count = 0;
+    double findMs = timeMs([&] { found = doc.findParallel(needle, pool); });
+    double countMs = timeMs([&] { count = doc.countParallel(needle, pool); });
+    if (count != 1) std::printf("unexpected count %zu\n", count);
+    std::printf("%10zu %16.3f %16.3f %16.3f\n", threads, findMs, countMs, found / findMs / 1e6);
+  }
+  return 0;
+}
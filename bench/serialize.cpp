@@ -0,0 +1,73 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Compare saving and loading a rope in the binary format of rope::serialize with
+//   saving it as text and loading it with a rope_builder followed by balance()
+//
+// usage: serialize_bench [max bytes]
+//
+// Sizes run from 1 MiB up to the given maximum (64 MiB by default) in steps of 4x.
+//   Each document is built from leaves of 1 KiB and then given one small random
+//   insertion per 4 KiB, so that it has the irregular shape of an edited document.
+//   Both formats are written to and read from string streams, so that only the
+//   cost of the formats themselves is measured.
+
+#include "bench.hpp"
+#include "proj/builder.hpp"
+#include <cstdlib>
+#include <sstream>
+
+using namespace bench;
+
+// Written by every load so that it is not optimized away
+static volatile size_t sink;
+
+int main(int argc, char * argv[]) {
+  size_t maxBytes = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : (1 << 26);
+  std::mt19937 gen(1);
+
+  std::printf("%10s %12s %12s %12s %12s %12s %12s\n", "bytes", "text save", "text load",
+    "binary save", "binary load", "binary size", "depth");
+  for (size_t bytes = 1 << 20; bytes <= maxBytes; bytes *= 4) {
+    rope doc = makeDocument(bytes, 1024, gen);
+    for (size_t i = 0; i < bytes / 4096; i++) doc.insert(gen() % doc.length(), makeText(1 + gen() % 8, gen));
+
+    string text;
+    double textSave = timeMs([&] {
+      std::ostringstream out;
+      out << doc;
+      text = out.str();
+    });
+    double textLoad = timeMs([&] {
+      std::istringstream in(text);
+      string read(text.length(), '\0');
+      in.read(&read[0], read.length());
+      proj::rope_builder builder;
+      rope loaded = builder.append(read).build();
+      loaded.balance();
+      sink = loaded.length();
+    });
+
+    string binary;
+    double binarySave = timeMs([&] {
+      std::ostringstream out;
+      doc.serialize(out);
+      binary = out.str();
+    });
+    size_t depth = 0;
+    double binaryLoad = timeMs([&] {
+      std::istringstream in(binary);
+      rope loaded = rope::deserialize(in);
+      depth = loaded.depth();
+      sink = loaded.length();
+    });
+
+    std::printf("%10zu %10.2fms %10.2fms %10.2fms %10.2fms %12zu %12zu\n", bytes, textSave, textLoad,
+      binarySave, binaryLoad, binary.length(), depth);
+  }
+  return 0;
+}
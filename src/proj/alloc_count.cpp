@@ -0,0 +1,82 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "alloc_count.hpp"
+#include <cstdlib>
+#include <new>
+
+namespace proj
+{
+  // counts of the calling thread, which are zero-initialized and so safe to update
+  //   from the first allocation a thread makes
+  static thread_local alloc_counts counted = { 0, 0 };
+  
+  // Count an allocation of (size) bytes and make it with malloc
+  static void * countedAlloc(size_t size) {
+    counted.allocations++;
+    counted.bytes += size;
+    return std::malloc(size == 0 ? 1 : size);
+  }
+  
+  // Get the allocations made by the calling thread since it started
+  alloc_counts threadAllocations(void) {
+    return counted;
+  }
+  
+  alloc_scope::alloc_scope(void) : start_(counted)
+  {}
+  
+  // Get the allocations made since the scope was constructed
+  alloc_counts alloc_scope::counts(void) const {
+    return alloc_counts{ counted.allocations - this->start_.allocations, counted.bytes - this->start_.bytes };
+  }
+
+} // namespace proj
+
+// Replacements for the global allocation functions
+
+void * operator new(size_t size) {
+  void * p = proj::countedAlloc(size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+void * operator new[](size_t size) {
+  return operator new(size);
+}
+
+void * operator new(size_t size, const std::nothrow_t&) noexcept {
+  return proj::countedAlloc(size);
+}
+
+void * operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return proj::countedAlloc(size);
+}
+
+void operator delete(void * p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void * p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void * p, size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete(void * p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void * p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
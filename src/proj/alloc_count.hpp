@@ -0,0 +1,45 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <cstddef>
+
+namespace proj
+{
+  // Allocation counting
+  //
+  // Linking the proj_alloc_count library replaces the global operator new and
+  //   operator delete with versions which count, for each thread, the allocations it
+  //   makes and the bytes it requests. The library is opt-in: it is linked by the
+  //   tests and the benchmarks, and programs which do not link it allocate as usual.
+  
+  // Number of allocations and bytes requested
+  struct alloc_counts {
+    size_t allocations;
+    size_t bytes;
+  };
+  
+  // Get the allocations made by the calling thread since it started
+  alloc_counts threadAllocations(void);
+  
+  // Counts the allocations made by the calling thread during the lifetime of the scope
+  class alloc_scope {
+  
+  public:
+    
+    alloc_scope(void);
+    // Get the allocations made since the scope was constructed
+    alloc_counts counts(void) const;
+  
+  private:
+    
+    alloc_counts start_;
+  
+  }; // class alloc_scope
+
+} // namespace proj
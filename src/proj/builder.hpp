@@ -0,0 +1,144 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include "rope.hpp"
+
+namespace proj
+{
+  // default length of the leaves produced by a rope_builder
+  const size_t DEFAULT_LEAF_LENGTH = 1024;
+  
+  // A rope_builder assembles a rope from a sequence of pieces in O(n) time
+  //
+  // Pieces are packed into leaves of a fixed length as they arrive, so a document
+  //   assembled from many small strings has no more leaves than its length requires.
+  //   Leaves of appended ropes which are at least half that length are shared rather
+  //   than copied. Building the rope then concatenates the leaves into a tree of
+  //   minimal depth in a single pass, which always satisfies isBalanced.
+  
+  template <typename Summary>
+  class basic_rope_builder {
+  
+  public:
+    
+    using rope_type = basic_rope<Summary>;
+    
+    // CONSTRUCTORS
+    // Construct a builder producing leaves of (leafLength) chars
+    explicit basic_rope_builder(size_t leafLength = DEFAULT_LEAF_LENGTH);
+    
+    // ACCESSORS
+    // Get the number of chars appended since the last rope was built
+    size_t length(void) const;
+    
+    // MUTATORS
+    // Append the given string/chars/rope to the rope being built
+    basic_rope_builder& append(const string& str);
+    basic_rope_builder& append(const char * data, size_t len);
+    basic_rope_builder& append(const rope_type& r);
+    // Get the rope formed by the pieces appended since the last rope was built, and
+    //   reset the builder
+    rope_type build(void);
+  
+  private:
+    
+    using handle = node_handle<Summary>;
+    
+    // Make a leaf of the pending chars
+    void flush(void);
+    
+    size_t leafLength_;
+    size_t length_;
+    // Chars not yet placed in a leaf, never longer than leafLength_
+    string pending_;
+    std::vector<handle> leaves_;
+  
+  }; // class basic_rope_builder
+  
+  using rope_builder = basic_rope_builder<no_summary>;
+  
+  // Construct a builder producing leaves of (leafLength) chars
+  template <typename Summary>
+  basic_rope_builder<Summary>::basic_rope_builder(size_t leafLength)
+    : leafLength_(std::max(leafLength, size_t(1))), length_(0)
+  {
+    this->pending_.reserve(this->leafLength_);
+  }
+  
+  // Get the number of chars appended since the last rope was built
+  template <typename Summary>
+  size_t basic_rope_builder<Summary>::length(void) const {
+    return this->length_;
+  }
+  
+  // Append the given string to the rope being built
+  template <typename Summary>
+  basic_rope_builder<Summary>& basic_rope_builder<Summary>::append(const string& str) {
+    return this->append(str.data(), str.length());
+  }
+  
+  // Append the given chars to the rope being built, filling the pending leaf before
+  //   starting another
+  template <typename Summary>
+  basic_rope_builder<Summary>& basic_rope_builder<Summary>::append(const char * data, size_t len) {
+    this->length_ += len;
+    while (len > 0) {
+      size_t n = std::min(len, this->leafLength_ - this->pending_.length());
+      this->pending_.append(data, n);
+      data += n;
+      len -= n;
+      if (this->pending_.length() == this->leafLength_) this->flush();
+    }
+    return *this;
+  }
+  
+  // Append the given rope to the rope being built
+  //
+  // Short leaves are packed with the surrounding chars, and the rest are shared.
+  template <typename Summary>
+  basic_rope_builder<Summary>& basic_rope_builder<Summary>::append(const rope_type& r) {
+    std::vector<handle> leaves;
+    getLeaves(r.root_, leaves);
+    for (const handle& leaf : leaves) {
+      size_t len = leaf->getLength();
+      if (len * 2 < this->leafLength_) {
+        this->append(leaf->getSubstring(0, len));
+      } else {
+        this->flush();
+        this->leaves_.push_back(leaf);
+        this->length_ += len;
+      }
+    }
+    return *this;
+  }
+  
+  // Get the rope formed by the pieces appended since the last rope was built
+  template <typename Summary>
+  basic_rope<Summary> basic_rope_builder<Summary>::build(void) {
+    this->flush();
+    rope_type result;
+    if (!this->leaves_.empty()) {
+      result.root_ = buildTree(this->leaves_.data(), this->leaves_.data() + this->leaves_.size());
+    }
+    this->leaves_.clear();
+    this->length_ = 0;
+    return result;
+  }
+  
+  // Make a leaf of the pending chars, keeping the buffer for the next leaf
+  template <typename Summary>
+  void basic_rope_builder<Summary>::flush(void) {
+    if (this->pending_.empty()) return;
+    this->leaves_.push_back(std::make_shared<const basic_rope_node<Summary>>(this->pending_));
+    this->pending_.clear();
+  }
+  
+  extern template class basic_rope_builder<no_summary>;
+
+} // namespace proj
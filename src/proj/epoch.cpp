@@ -0,0 +1,84 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "epoch.hpp"
+#include <atomic>
+#include <cstddef>
+#include <limits>
+
+namespace proj
+{
+  // epoch recorded by a slot whose thread is not pinned
+  static const uint64_t UNPINNED = std::numeric_limits<uint64_t>::max();
+  
+  // A slot records the epoch in which a thread is pinned
+  //
+  // Slots are kept in a lock-free list and are never freed; a slot released by an
+  //   exiting thread is reused by the next thread to start pinning.
+  struct epoch_slot {
+    std::atomic<uint64_t> epoch;
+    std::atomic<bool> owned;
+    epoch_slot * next;
+  };
+  
+  static std::atomic<uint64_t> globalEpoch(1);
+  static std::atomic<epoch_slot *> slots(nullptr);
+  
+  // Claim an unowned slot, or add a new slot to the list if every slot is owned
+  static epoch_slot * acquireSlot(void) {
+    for (epoch_slot * s = slots.load(); s != nullptr; s = s->next) {
+      bool expected = false;
+      if (!s->owned.load() && s->owned.compare_exchange_strong(expected, true)) return s;
+    }
+    epoch_slot * s = new epoch_slot;
+    s->epoch.store(UNPINNED);
+    s->owned.store(true);
+    s->next = slots.load();
+    while (!slots.compare_exchange_weak(s->next, s)) {}
+    return s;
+  }
+  
+  // Owns the calling thread's slot for the lifetime of the thread
+  struct thread_slot {
+    epoch_slot * slot;
+    size_t depth;
+    thread_slot(void) : slot(acquireSlot()), depth(0) {}
+    ~thread_slot(void) {
+      this->slot->epoch.store(UNPINNED);
+      this->slot->owned.store(false);
+    }
+  };
+  
+  static thread_local thread_slot localSlot;
+  
+  // Pin the current thread in the current epoch, unless it is already pinned
+  epoch_guard::epoch_guard(void) {
+    if (localSlot.depth++ == 0) localSlot.slot->epoch.store(globalEpoch.load());
+  }
+  
+  // Unpin the current thread, once the outermost guard is destroyed
+  epoch_guard::~epoch_guard(void) {
+    if (--localSlot.depth == 0) localSlot.slot->epoch.store(UNPINNED);
+  }
+  
+  // Advance the global epoch, returning the epoch in which an object unpublished
+  //   before the call is retired
+  uint64_t retireEpoch(void) {
+    return globalEpoch.fetch_add(1);
+  }
+  
+  // Get the oldest epoch in which any thread is currently pinned
+  uint64_t oldestPinnedEpoch(void) {
+    uint64_t oldest = globalEpoch.load();
+    for (epoch_slot * s = slots.load(); s != nullptr; s = s->next) {
+      uint64_t e = s->epoch.load();
+      if (e < oldest) oldest = e;
+    }
+    return oldest;
+  }
+
+} // namespace proj
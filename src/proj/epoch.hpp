@@ -0,0 +1,45 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <cstdint>
+
+namespace proj
+{
+  // Epoch-based reclamation
+  //
+  // An object which has been unpublished (so that no thread can newly obtain a
+  //   pointer to it) may still be in use by threads which obtained a pointer to it
+  //   earlier. Such threads obtain pointers only while pinned by an epoch_guard, which
+  //   records the global epoch at the time of pinning.
+  //
+  // To reclaim an object, a thread first unpublishes it and then retires it, taking
+  //   the epoch returned by retireEpoch(). The object may be destroyed as soon as
+  //   oldestPinnedEpoch() exceeds that epoch, since every thread pinned since then
+  //   can only have obtained pointers to objects published in its place.
+  
+  // Pins the current thread for the lifetime of the guard; guards may be nested
+  class epoch_guard {
+  
+  public:
+    
+    epoch_guard(void);
+    ~epoch_guard(void);
+    epoch_guard(const epoch_guard&) = delete;
+    epoch_guard& operator=(const epoch_guard&) = delete;
+  
+  }; // class epoch_guard
+  
+  // Advance the global epoch, returning the epoch in which an object unpublished
+  //   before the call is retired
+  uint64_t retireEpoch(void);
+  // Get the oldest epoch in which any thread is currently pinned, or the current
+  //   epoch if no thread is pinned
+  uint64_t oldestPinnedEpoch(void);
+
+} // namespace proj
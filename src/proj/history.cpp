@@ -0,0 +1,18 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "history.hpp"
+
+namespace proj
+{
+  // no-such-version error constant
+  std::invalid_argument ERROR_NO_VERSION = std::invalid_argument("Error: no such version");
+  
+  // Instantiate the history of the default rope
+  template class basic_rope_history<no_summary>;
+
+} // namespace proj
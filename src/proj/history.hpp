@@ -0,0 +1,220 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <deque>
+#include <limits>
+#include "rope.hpp"
+
+namespace proj
+{
+  // no-such-version error constant
+  extern std::invalid_argument ERROR_NO_VERSION;
+  
+  // A rope_history records successive versions of a rope, supporting undo and redo
+  //
+  // Versions share structure with one another, so recording a version retains only
+  //   the nodes rebuilt by the edits made since the previous version was recorded.
+  //   Versions are numbered consecutively from 0, and the current version may be
+  //   moved to any recorded version in O(1) time.
+  //
+  // The memory retained by a version is estimated, when it is recorded, as the size
+  //   of its nodes which are not shared with any other rope. Whenever the total for
+  //   all but the oldest version exceeds the budget, the oldest versions are dropped.
+  
+  template <typename Summary>
+  class basic_rope_history {
+  
+  public:
+    
+    using rope_type = basic_rope<Summary>;
+    
+    // CONSTRUCTORS
+    // Construct a history whose only version is the given rope, retaining an
+    //   estimated (budget) bytes of past versions
+    basic_rope_history(const rope_type& initial = rope_type(),
+                       size_t budget = std::numeric_limits<size_t>::max());
+    
+    // ACCESSORS
+    // Get the current version
+    const rope_type& current(void) const;
+    // Get the number of the current version
+    size_t version(void) const;
+    // Get the numbers of the oldest and newest retained versions
+    size_t oldestVersion(void) const;
+    size_t newestVersion(void) const;
+    // Determine whether an older/newer version than the current version is retained
+    bool canUndo(void) const;
+    bool canRedo(void) const;
+    // Get the estimated number of bytes retained by versions other than the oldest
+    size_t memoryUsage(void) const;
+    // Get the budget for the memory usage
+    size_t budget(void) const;
+    
+    // MUTATORS
+    // Record the given rope as the newest version, discarding any versions newer than
+    //   the current version, and return the number of the recorded version
+    size_t commit(const rope_type& r);
+    // Move to the previous/next version, returning the new current version
+    const rope_type& undo(void);
+    const rope_type& redo(void);
+    // Move to the given version, returning the new current version
+    const rope_type& jumpTo(size_t version);
+    // Set the budget for the memory usage, dropping the oldest versions as necessary
+    void setBudget(size_t budget);
+  
+  private:
+    
+    // A recorded version and the estimated number of bytes it retains
+    struct entry {
+      rope_type text;
+      size_t bytes;
+    };
+    
+    // Drop the oldest versions until the memory usage is within the budget
+    void enforceBudget(void);
+    
+    std::deque<entry> versions_;
+    // Number of the oldest retained version
+    size_t first_;
+    // Index of the current version in versions_
+    size_t current_;
+    size_t bytes_;
+    size_t budget_;
+  
+  }; // class basic_rope_history
+  
+  using rope_history = basic_rope_history<no_summary>;
+  
+  // Construct a history whose only version is the given rope
+  template <typename Summary>
+  basic_rope_history<Summary>::basic_rope_history(const rope_type& initial, size_t budget)
+    : first_(0), current_(0), bytes_(0), budget_(budget)
+  {
+    this->versions_.push_back(entry{initial, 0});
+  }
+  
+  // Get the current version
+  template <typename Summary>
+  const basic_rope<Summary>& basic_rope_history<Summary>::current(void) const {
+    return this->versions_[this->current_].text;
+  }
+  
+  // Get the number of the current version
+  template <typename Summary>
+  size_t basic_rope_history<Summary>::version(void) const {
+    return this->first_ + this->current_;
+  }
+  
+  // Get the number of the oldest retained version
+  template <typename Summary>
+  size_t basic_rope_history<Summary>::oldestVersion(void) const {
+    return this->first_;
+  }
+  
+  // Get the number of the newest retained version
+  template <typename Summary>
+  size_t basic_rope_history<Summary>::newestVersion(void) const {
+    return this->first_ + this->versions_.size() - 1;
+  }
+  
+  // Determine whether an older version than the current version is retained
+  template <typename Summary>
+  bool basic_rope_history<Summary>::canUndo(void) const {
+    return this->current_ > 0;
+  }
+  
+  // Determine whether a newer version than the current version is retained
+  template <typename Summary>
+  bool basic_rope_history<Summary>::canRedo(void) const {
+    return this->current_ + 1 < this->versions_.size();
+  }
+  
+  // Get the estimated number of bytes retained by versions other than the oldest
+  template <typename Summary>
+  size_t basic_rope_history<Summary>::memoryUsage(void) const {
+    return this->bytes_;
+  }
+  
+  // Get the budget for the memory usage
+  template <typename Summary>
+  size_t basic_rope_history<Summary>::budget(void) const {
+    return this->budget_;
+  }
+  
+  // Record the given rope as the newest version
+  //
+  // Only the nodes which the given rope does not share with the previous version
+  //   are counted, so recording a version costs time proportional to the edits made
+  //   since the previous version rather than to the length of the rope.
+  template <typename Summary>
+  size_t basic_rope_history<Summary>::commit(const rope_type& r) {
+    // discard versions which could have been redone
+    while (this->canRedo()) {
+      this->bytes_ -= this->versions_.back().bytes;
+      this->versions_.pop_back();
+    }
+    
+    size_t bytes = 0;
+    if (r.root_ != this->current().root_) {
+      // the root is also referenced by the given rope, so it is counted explicitly
+      bytes = r.root_->getUnsharedBytes();
+    }
+    this->versions_.push_back(entry{r, bytes});
+    this->bytes_ += bytes;
+    this->current_++;
+    this->enforceBudget();
+    return this->version();
+  }
+  
+  // Move to the previous version
+  template <typename Summary>
+  const basic_rope<Summary>& basic_rope_history<Summary>::undo(void) {
+    if (!this->canUndo()) throw ERROR_NO_VERSION;
+    return this->versions_[--this->current_].text;
+  }
+  
+  // Move to the next version
+  template <typename Summary>
+  const basic_rope<Summary>& basic_rope_history<Summary>::redo(void) {
+    if (!this->canRedo()) throw ERROR_NO_VERSION;
+    return this->versions_[++this->current_].text;
+  }
+  
+  // Move to the given version
+  template <typename Summary>
+  const basic_rope<Summary>& basic_rope_history<Summary>::jumpTo(size_t version) {
+    if (version < this->oldestVersion() || version > this->newestVersion()) throw ERROR_NO_VERSION;
+    this->current_ = version - this->first_;
+    return this->current();
+  }
+  
+  // Set the budget for the memory usage
+  template <typename Summary>
+  void basic_rope_history<Summary>::setBudget(size_t budget) {
+    this->budget_ = budget;
+    this->enforceBudget();
+  }
+  
+  // Drop the oldest versions until the memory usage is within the budget, never
+  //   dropping the current version
+  template <typename Summary>
+  void basic_rope_history<Summary>::enforceBudget(void) {
+    while (this->bytes_ > this->budget_ && this->current_ > 0) {
+      this->versions_.pop_front();
+      // the new oldest version is no longer counted against the budget
+      this->bytes_ -= this->versions_.front().bytes;
+      this->versions_.front().bytes = 0;
+      this->first_++;
+      this->current_--;
+    }
+  }
+  
+  extern template class basic_rope_history<no_summary>;
+
+} // namespace proj
@@ -0,0 +1,256 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "latency.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace proj
+{
+  latency_histogram::latency_histogram(void) : total_(0) {
+    this->counts_.fill(0);
+  }
+  
+  // Count a latency of (ns) nanoseconds
+  void latency_histogram::record(uint64_t ns) {
+    this->counts_[bucketOf(ns)]++;
+    this->total_++;
+  }
+  
+  // Count (n) latencies in the given bucket
+  void latency_histogram::recordBucket(size_t bucket, uint64_t n) {
+    this->counts_[bucket] += n;
+    this->total_ += n;
+  }
+  
+  // Add the counts of the given histogram to this one
+  void latency_histogram::merge(const latency_histogram& other) {
+    for (size_t i = 0; i < BUCKETS; i++) this->counts_[i] += other.counts_[i];
+    this->total_ += other.total_;
+  }
+  
+  // Remove the counts of the given histogram from this one
+  void latency_histogram::subtract(const latency_histogram& other) {
+    for (size_t i = 0; i < BUCKETS; i++) this->counts_[i] -= other.counts_[i];
+    this->total_ -= other.total_;
+  }
+  
+  // Get the number of latencies counted
+  uint64_t latency_histogram::count(void) const {
+    return this->total_;
+  }
+  
+  // Get the greatest latency of the bucket holding the given fraction of the latencies
+  uint64_t latency_histogram::percentile(double fraction) const {
+    if (this->total_ == 0) return 0;
+    // the rank of the latency sought, counting from 1
+    uint64_t rank = static_cast<uint64_t>(fraction * this->total_);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+      seen += this->counts_[i];
+      if (seen >= rank) return bucketMax(i);
+    }
+    return bucketMax(BUCKETS - 1);
+  }
+  
+  // Get the number of latencies counted in the given bucket
+  uint64_t latency_histogram::bucketCount(size_t bucket) const {
+    return this->counts_[bucket];
+  }
+  
+  // Get the bucket which counts a latency of (ns) nanoseconds
+  //
+  // A latency whose highest set bit is bit m (for m of 4 or more) falls in the group
+  //   of 8 buckets for m, and within it in the bucket given by the 3 bits below m.
+  size_t latency_histogram::bucketOf(uint64_t ns) {
+    if (ns < 16) return static_cast<size_t>(ns);
+    // the highest set bit, found in a single instruction where the compiler offers
+    //   one, and otherwise by halving the range of bits searched
+#if defined(__GNUC__) || defined(__clang__)
+    size_t m = 63 - static_cast<size_t>(__builtin_clzll(ns));
+#else
+    size_t m = 0;
+    for (size_t shift = 32; shift > 0; shift /= 2) {
+      if ((ns >> (m + shift)) != 0) m += shift;
+    }
+#endif
+    return 16 + (m - 4) * 8 + static_cast<size_t>((ns >> (m - 3)) & 7);
+  }
+  
+  // Get the greatest latency counted by the given bucket
+  uint64_t latency_histogram::bucketMax(size_t bucket) {
+    if (bucket < 16) return bucket;
+    size_t m = 4 + (bucket - 16) / 8;
+    uint64_t sub = (bucket - 16) % 8;
+    uint64_t width = uint64_t(1) << (m - 3);
+    return ((8 + sub) << (m - 3)) + (width - 1);
+  }
+  
+  // The histograms recorded by a single thread
+  //
+  // Only the owning thread writes the counts, so it updates them with a relaxed load
+  //   and store rather than a read-modify-write, and other threads may read them at
+  //   any time.
+  struct latency_buffer {
+    std::atomic<uint64_t> counts[ROPE_OP_COUNT][latency_histogram::BUCKETS];
+    latency_buffer(void) {
+      for (auto& op : this->counts) {
+        for (auto& c : op) c.store(0, std::memory_order_relaxed);
+      }
+    }
+  };
+  
+  // The buffers of running threads, the histograms of threads which have exited, and
+  //   the histograms subtracted from snapshots by the last reset
+  static std::mutex registryLock;
+  static std::vector<latency_buffer *> buffers;
+  static latency_histogram retired[ROPE_OP_COUNT];
+  static latency_histogram resetBaseline[ROPE_OP_COUNT];
+  static std::atomic<size_t> samplePeriod(16);
+  
+  // The buffer of the calling thread, or null if it has none
+  static thread_local latency_buffer * currentBuffer = nullptr;
+  // Whether the calling thread has exited, and its buffer been retired
+  static thread_local bool bufferRetired = false;
+  
+  // Owns the buffer of a thread, which on the thread's exit is merged into the
+  //   retired histograms and freed
+  struct latency_buffer_owner {
+    std::unique_ptr<latency_buffer> buffer;
+    latency_buffer_owner(void) : buffer(new latency_buffer) {
+      std::lock_guard<std::mutex> hold(registryLock);
+      buffers.push_back(this->buffer.get());
+    }
+    ~latency_buffer_owner(void) {
+      std::lock_guard<std::mutex> hold(registryLock);
+      for (size_t op = 0; op < ROPE_OP_COUNT; op++) {
+        for (size_t i = 0; i < latency_histogram::BUCKETS; i++) {
+          retired[op].recordBucket(i, this->buffer->counts[op][i].load(std::memory_order_relaxed));
+        }
+      }
+      buffers.erase(std::find(buffers.begin(), buffers.end(), this->buffer.get()));
+      currentBuffer = nullptr;
+      bufferRetired = true;
+    }
+  };
+  
+  // Get the buffer of the calling thread, registering it on first use, or null if the
+  //   thread is exiting and its buffer has been retired
+  static latency_buffer * threadBuffer(void) {
+    if (currentBuffer == nullptr && !bufferRetired) {
+      static thread_local latency_buffer_owner owner;
+      currentBuffer = owner.buffer.get();
+    }
+    return currentBuffer;
+  }
+  
+  // Record a latency for the given operation on the calling thread
+  //
+  // A latency recorded by a thread after its buffer was retired (as by the destructor
+  //   of another thread-local object) is merged directly into the retired histograms.
+  void recordLatency(rope_op op, uint64_t ns) {
+    latency_buffer * buffer = threadBuffer();
+    if (buffer == nullptr) {
+      std::lock_guard<std::mutex> hold(registryLock);
+      retired[static_cast<size_t>(op)].record(ns);
+      return;
+    }
+    std::atomic<uint64_t>& c = buffer->counts[static_cast<size_t>(op)][latency_histogram::bucketOf(ns)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+  
+  // Get the nanoseconds per tick of latencyTicks, in fixed point with 32 fractional bits
+  //
+  // The cycle counter runs at a constant rate on the processors which have one, so
+  //   its rate is measured once against the steady clock, over a millisecond.
+  static uint64_t nanosPerTick(void) {
+#ifdef PROJ_CYCLE_COUNTER
+    static const uint64_t rate = [](void) {
+      auto start = std::chrono::steady_clock::now();
+      uint64_t startTicks = latencyTicks();
+      std::chrono::steady_clock::duration elapsed;
+      do {
+        elapsed = std::chrono::steady_clock::now() - start;
+      } while (elapsed < std::chrono::milliseconds(1));
+      uint64_t ticks = latencyTicks() - startTicks;
+      uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+      // keep (ns << 32) within 64 bits, should the thread have been held up for seconds
+      while (ns >= (uint64_t(1) << 31)) {
+        ns >>= 1;
+        ticks >>= 1;
+      }
+      return (ticks == 0) ? (uint64_t(1) << 32) : (ns << 32) / ticks;
+    }();
+    return rate;
+#else
+    return uint64_t(1) << 32;
+#endif
+  }
+  
+  // Record a latency of (ticks) latencyTicks() for the given operation on the calling
+  //   thread
+  //
+  // The product of the ticks and the rate needs 96 bits, so it is taken in 128 bits on
+  //   x86-64 and otherwise in two 64-bit halves: (hi * 2^32 + lo) * rate >> 32 is
+  //   hi * rate + (lo * rate >> 32), where the rate is at most 2^32 for any clock of
+  //   at least one tick per nanosecond.
+  void recordTicks(rope_op op, uint64_t ticks) {
+    uint64_t rate = nanosPerTick();
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    recordLatency(op, static_cast<uint64_t>((static_cast<unsigned __int128>(ticks) * rate) >> 32));
+#else
+    recordLatency(op, (ticks >> 32) * rate + (((ticks & 0xFFFFFFFF) * rate) >> 32));
+#endif
+  }
+  
+  // Get the number of operations on each thread per operation timed
+  size_t latencySamplePeriod(void) {
+    return samplePeriod.load(std::memory_order_relaxed);
+  }
+  
+  // Set the number of operations on each thread per operation timed
+  void setLatencySamplePeriod(size_t period) {
+    samplePeriod.store(std::max(period, size_t(1)), std::memory_order_relaxed);
+  }
+  
+  // Merge the histograms of every thread, running or exited, for the given operation;
+  //   the registry lock must be held
+  static latency_histogram mergeBuffers(rope_op op) {
+    latency_histogram merged = retired[static_cast<size_t>(op)];
+    for (const latency_buffer * b : buffers) {
+      for (size_t i = 0; i < latency_histogram::BUCKETS; i++) {
+        merged.recordBucket(i, b->counts[static_cast<size_t>(op)][i].load(std::memory_order_relaxed));
+      }
+    }
+    return merged;
+  }
+  
+  // Get the latencies recorded by every thread for the given operation since the
+  //   last reset
+  latency_histogram latencySnapshot(rope_op op) {
+    std::lock_guard<std::mutex> hold(registryLock);
+    latency_histogram snapshot = mergeBuffers(op);
+    snapshot.subtract(resetBaseline[static_cast<size_t>(op)]);
+    return snapshot;
+  }
+  
+  // Discard the latencies recorded so far
+  //
+  // Buffers are written only by their threads, so rather than clearing them a reset
+  //   records their current counts, which later snapshots subtract.
+  void resetLatencies(void) {
+    std::lock_guard<std::mutex> hold(registryLock);
+    for (size_t op = 0; op < ROPE_OP_COUNT; op++) {
+      resetBaseline[op] = mergeBuffers(static_cast<rope_op>(op));
+    }
+  }
+
+} // namespace proj
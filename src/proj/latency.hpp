@@ -0,0 +1,151 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+// PROJ_CYCLE_COUNTER is defined where latencies are timed by the x86 cycle counter
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROJ_CYCLE_COUNTER
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROJ_CYCLE_COUNTER
+#endif
+
+namespace proj
+{
+  // Latency histograms
+  //
+  // When built with PROJ_LATENCY_HISTOGRAMS defined (the CMake option of the same
+  //   name, off by default), ropes record the latency of the operations below. Each
+  //   thread records into histograms of its own, so recording takes no lock and
+  //   contends with no other thread; latencySnapshot merges the histograms of every
+  //   thread, including those of threads which have exited. Otherwise nothing is
+  //   recorded and the ropes pay nothing.
+  //
+  // Reading a clock costs more than many rope operations, so only one operation in
+  //   every latencySamplePeriod() on each thread is timed, against the cycle counter
+  //   where the processor has one; the histograms count the timed operations.
+  
+  // The operations whose latencies are recorded
+  enum class rope_op { insert, rdelete, substring, balance };
+  const size_t ROPE_OP_COUNT = 4;
+  
+  // A latency_histogram counts latencies in log-linear buckets, as in an HDR
+  //   histogram: latencies under 16 ns have a bucket each, and each larger power of
+  //   two is divided into 8 buckets, so that a latency is known to within 12.5%.
+  
+  class latency_histogram {
+  
+  public:
+    
+    // the number of buckets, enough for any latency of 64 bits
+    static const size_t BUCKETS = 16 + 60 * 8;
+    
+    latency_histogram(void);
+    
+    // Count a latency of (ns) nanoseconds
+    void record(uint64_t ns);
+    // Count (n) latencies in the given bucket
+    void recordBucket(size_t bucket, uint64_t n);
+    // Add the counts of the given histogram to this one
+    void merge(const latency_histogram& other);
+    // Remove the counts of the given histogram, which must have been merged into
+    //   this one, from this one
+    void subtract(const latency_histogram& other);
+    
+    // Get the number of latencies counted
+    uint64_t count(void) const;
+    // Get the greatest latency of the bucket holding the given fraction of the
+    //   latencies (e.g. 0.99 for the 99th percentile), or 0 if none are counted
+    uint64_t percentile(double fraction) const;
+    // Get the number of latencies counted in the given bucket
+    uint64_t bucketCount(size_t bucket) const;
+    
+    // Get the bucket which counts a latency of (ns) nanoseconds
+    static size_t bucketOf(uint64_t ns);
+    // Get the greatest latency counted by the given bucket
+    static uint64_t bucketMax(size_t bucket);
+  
+  private:
+    
+    std::array<uint64_t, BUCKETS> counts_;
+    uint64_t total_;
+  
+  }; // class latency_histogram
+  
+  // Record a latency of (ns) nanoseconds for the given operation on the calling thread
+  void recordLatency(rope_op op, uint64_t ns);
+  // Record a latency of (ticks) latencyTicks() for the given operation on the calling
+  //   thread
+  void recordTicks(rope_op op, uint64_t ticks);
+  // Get the latencies recorded by every thread for the given operation since the
+  //   last reset
+  latency_histogram latencySnapshot(rope_op op);
+  // Discard the latencies recorded so far, for every operation
+  void resetLatencies(void);
+  // Get or set the number of operations on each thread per operation timed, 1 to
+  //   time every operation
+  size_t latencySamplePeriod(void);
+  void setLatencySamplePeriod(size_t period);
+  
+  // Read the clock by which latencies are timed: the cycle counter on x86, which is
+  //   read without a call into the kernel or the C library, and otherwise the
+  //   nanoseconds of the steady clock
+  inline uint64_t latencyTicks(void) {
+#ifdef PROJ_CYCLE_COUNTER
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+  }
+  
+  // Determine whether the calling thread's next operation is one to time
+  inline bool sampleNextOp(void) {
+    static thread_local size_t untimed = 0;
+    if (++untimed < latencySamplePeriod()) return false;
+    untimed = 0;
+    return true;
+  }
+  
+  // Records the lifetime of the timer as a latency of the given operation, if the
+  //   operation is one sampled
+  class latency_timer {
+  
+  public:
+    
+    explicit latency_timer(rope_op op)
+      : op_(op), sampled_(sampleNextOp()), start_(sampled_ ? latencyTicks() : 0)
+    {}
+    ~latency_timer(void) {
+      if (this->sampled_) recordTicks(this->op_, latencyTicks() - this->start_);
+    }
+    latency_timer(const latency_timer&) = delete;
+    latency_timer& operator=(const latency_timer&) = delete;
+  
+  private:
+    
+    rope_op op_;
+    bool sampled_;
+    uint64_t start_;
+  
+  }; // class latency_timer
+
+} // namespace proj
+
+// Time the rest of the enclosing scope as an instance of the given operation, if
+//   latency histograms are enabled
+#ifdef PROJ_LATENCY_HISTOGRAMS
+#define PROJ_TIME_OP(op) ::proj::latency_timer proj_latency_timer_(::proj::rope_op::op)
+#else
+#define PROJ_TIME_OP(op)
+#endif
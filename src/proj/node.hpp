@@ -7,14 +7,115 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <iosfwd>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#include "parallel.hpp"
+#include "trace.hpp"
 
 namespace proj
 {
   using std::string;
   
+  // out-of-bounds error constant
+  extern std::invalid_argument ERROR_OOB_NODE;
+  // malformed serialized rope error constant
+  extern std::invalid_argument ERROR_BAD_SERIALIZATION;
+  
+  // Get the number of UTF-16 code units contributed by a single UTF-8 byte
+  size_t utf16Units(char c);
+  // Count the UTF-16 code units encoding the bytes in [begin, end) of the given string
+  size_t countUtf16(const string& str, size_t begin, size_t end);
+  // Count the newline characters in [begin, end) of the given string
+  size_t countNewlines(const string& str, size_t begin, size_t end);
+  
+  // Helpers for writeTree and readTree
+  // Append the given integer to the buffer as 8 little-endian bytes
+  void putU64(string& buf, uint64_t v);
+  // Get the integer stored as 8 little-endian bytes at the given address
+  uint64_t getU64(const char * p);
+  // Read exactly (len) bytes from the stream, throwing ERROR_BAD_SERIALIZATION if
+  //   the stream ends first
+  string readExactly(std::istream& in, uint64_t len);
+  // Write the given bytes to the stream
+  void writeBytes(std::ostream& out, const string& bytes);
+  
+  // A summary is a value cached on every node of a rope which describes the string
+  //   held in that node's subtree. A Summary type must provide:
+  //   - a default constructor, producing the summary of the empty string
+  //   - a constructor from a string, producing the summary of that string
+  //   - an associative operator+, where (a + b) summarises the string summarised
+  //     by a followed by the string summarised by b
+  //
+  // The summary of any string must equal the combination of the summaries of its
+  //   individual characters, so that summaries are unaffected by the way a string
+  //   is divided into fragments.
+  
+  // An edit replaces the (deleteLen) chars beginning at (offset) with (insertText)
+  struct rope_edit {
+    size_t offset;
+    size_t deleteLen;
+    string insertText;
+  };
+  
+  // Structural statistics of a rope's tree, for monitoring the shape of documents
+  struct rope_stats {
+    // number of nodes, internal and leaf
+    size_t nodes;
+    size_t leaves;
+    size_t emptyLeaves;
+    size_t depth;
+    // leafSizes[i] counts the non-empty leaves of [2^i, 2^(i+1)) chars
+    std::vector<size_t> leafSizes;
+    // bytes of text held in leaves, against the bytes of the blocks make_shared
+    //   allocates for the nodes together with their reference counts (excluding the
+    //   heap allocator's own bookkeeping)
+    size_t textBytes;
+    size_t overheadBytes;
+    // number of nodes also reachable from another rope (or another version of the
+    //   same rope), i.e. nodes in a subtree whose root has more than one reference
+    size_t sharedNodes;
+  };
+  
+  // The trivial summary, which caches nothing
+  struct no_summary {
+    no_summary(void) {}
+    explicit no_summary(const string&) {}
+    no_summary operator+(const no_summary&) const { return no_summary(); }
+  };
+  
+  // Storage for the summary cached on a node; empty summary types occupy no space
+  template <typename Summary, bool = std::is_empty<Summary>::value>
+  class summary_storage {
+  protected:
+    const Summary& getStoredSummary(void) const { return this->summary_; }
+    void setStoredSummary(const Summary& s) { this->summary_ = s; }
+  private:
+    Summary summary_;
+  };
+  
+  template <typename Summary>
+  class summary_storage<Summary, true> : private Summary {
+  protected:
+    const Summary& getStoredSummary(void) const { return *this; }
+    void setStoredSummary(const Summary&) {}
+  };
+  
+  template <typename Summary>
+  class basic_rope_node;
+  
+  // Nodes are immutable once constructed, so that any number of ropes (and any number
+  //   of versions of a rope) may share a subtree. A node is referred to by a handle,
+  //   which shares ownership of the node.
+  template <typename Summary>
+  using node_handle = std::shared_ptr<const basic_rope_node<Summary>>;
+  
   // A rope_node represents a string as a binary tree of string fragments
   //
   // A rope_node consists of:
@@ -22,6 +123,7 @@ namespace proj
   //   - a pointer to a left child rope_node
   //   - a pointer to a right child rope_node
   //   - a string fragment
+  //   - a summary of the string contained in the node and its children
   //
   // INVARIANTS:
   //   - a leaf is represented as a rope_node with null child pointers
@@ -30,47 +132,1144 @@ namespace proj
   //     an empty string fragment
   //   - an internal node's weight is equal to the length of the string fragment
   //     contained in (the leaf nodes of) its left subtree
-
-  class rope_node {
-    
+  //   - the UTF-16 weight and line weight of a node count, respectively, the UTF-16
+  //     code units and the newline characters in the same bytes as its weight
+  //   - a leaf node's summary is the summary of its fragment, and an internal node's
+  //     summary is the combination of the summaries of its children
+  //   - a node's depth is 0 for a leaf, and otherwise 1 plus the greater depth of
+  //     its children
+  
+  template <typename Summary>
+  class basic_rope_node : private summary_storage<Summary> {
+  
   public:
-    using handle = std::unique_ptr<rope_node>;
+    using handle = node_handle<Summary>;
     
     // CONSTRUCTORS
     // Construct internal node by concatenating the given nodes
-    rope_node(handle l, handle r);
+    basic_rope_node(handle l, handle r);
     // Construct leaf node from the given string
-    rope_node(const string& str);
-    // Copy constructor
-    rope_node(const rope_node&);
+    basic_rope_node(const string& str);
+    // Construct leaf node from the given string, taking its buffer
+    basic_rope_node(string&& str);
+    // Copy constructor - the copy shares the children of the original
+    basic_rope_node(const basic_rope_node&) = default;
+    // Destructor - releases chains of nodes iteratively, however deep
+    ~basic_rope_node(void);
     
     // ACCESSORS
     size_t getLength(void) const;
+    // Get the number of UTF-16 code units needed to encode the (UTF-8) string
+    size_t getUtf16Length(void) const;
+    // Get the number of newline characters in the string
+    size_t getNewlineCount(void) const;
     char getCharByIndex(size_t) const;
     // Get the substring of (len) chars beginning at index (start)
     string getSubstring(size_t start, size_t len) const;
     // Get string contained in current node and its children
     string treeToString(void) const;
+    // Copy the string contained in current node and its children to the given buffer
+    void copyTo(char * dst) const;
+    // Copy the (len) chars beginning at index (start) to the given buffer
+    void copyRangeTo(size_t start, size_t len, char * dst) const;
+    
+    // POSITION CONVERSION
+    // Get the byte index of the code point containing the given UTF-16 offset
+    size_t getByteByUtf16(size_t units) const;
+    // Get the number of UTF-16 code units encoding the bytes before the given index
+    size_t getUtf16ByByte(size_t index) const;
+    // Get the byte index immediately following the given (1-based) newline
+    size_t getByteByNewline(size_t n) const;
+    // Get the number of newline characters before the given byte index
+    size_t getNewlinesByByte(size_t index) const;
+    
+    // SUMMARIES
+    // Get the summary of the string contained in current node and its children
+    const Summary& getSummary(void) const;
+    // Get the summary of the first (index) chars
+    Summary getPrefixSummary(size_t index) const;
+    // Get the length of the shortest prefix whose summary, combined onto (acc),
+    //   satisfies the predicate; (acc) accumulates the summaries passed over.
+    //   Returns string::npos if no prefix of this subtree satisfies the predicate.
+    template <typename Pred>
+    size_t seek(Pred& pred, Summary& acc) const;
     
     // MUTATORS
+    // Each of the following builds new nodes along the affected paths and shares
+    //   every untouched subtree of the given node
     // Split the represented string at the specified index
-    friend std::pair<handle, handle> splitAt(handle, size_t);
+    template <typename S>
+    friend std::pair<node_handle<S>, node_handle<S>> splitAt(const node_handle<S>&, size_t);
+    // Concatenate the given subtrees, rebalancing along the spine of the deeper one
+    template <typename S>
+    friend node_handle<S> concatBalanced(const node_handle<S>&, const node_handle<S>&);
+    // Split the represented string at the specified index, rejoining the pieces on
+    //   either side of the split path with concatBalanced
+    template <typename S>
+    friend std::pair<node_handle<S>, node_handle<S>> splitBalanced(const node_handle<S>&, size_t);
+    // Rebalance only the subtrees failing the given balance condition, rejoining their
+    //   children (or, where not repairable, their balanced subtrees) with concatBalanced
+    //   and rebuilding those which remain unbalanced
+    template <typename S, typename Pred, typename Repairable, typename Rebuild>
+    friend node_handle<S> rebalanceLocal(const node_handle<S>&, const Pred& balanced,
+      const Repairable& repairable, const Rebuild& rebuild);
+    // Apply the given sorted, non-overlapping edits to the subtree representing the
+    //   chars beginning at index (lo)
+    template <typename S>
+    friend node_handle<S> applyEditsAt(const node_handle<S>&,
+      size_t lo, bool last, const rope_edit * begin, const rope_edit * end);
+    // Insert the given subtree at each of the given sorted indices of the subtree
+    //   representing the chars beginning at index (lo)
+    template <typename S>
+    friend node_handle<S> insertAllAt(const node_handle<S>&,
+      size_t lo, bool last, const size_t * begin, const size_t * end, const node_handle<S>& text);
     
     // HELPERS
     // Functions used in balancing
     size_t getDepth(void) const;
-    void getLeaves(std::vector<rope_node *>& v);
+    template <typename S>
+    friend void getLeaves(const node_handle<S>&, std::vector<node_handle<S>>& v);
+    // Reduce the subtree to a single value on the given pool, splitting subtrees of
+    //   more than (grain) chars between tasks
+    template <typename T, typename S, typename Leaf, typename Combine>
+    friend T parallelReduce(const node_handle<S>&, size_t offset, size_t grain,
+      task_pool& pool, const Leaf& leaf, const Combine& combine);
+    // Get the approximate number of bytes occupied by the node and every descendant
+    //   which is not shared with another node
+    size_t getUnsharedBytes(void) const;
+    // Get the structural statistics of the given subtree
+    template <typename S>
+    friend rope_stats getStats(const node_handle<S>&);
     
+    // SERIALIZATION
+    // Write the given subtree to the stream in the format of basic_rope::serialize
+    template <typename S>
+    friend void writeTree(const node_handle<S>&, std::ostream&);
+    // Read a subtree written by writeTree, or null if it was empty
+    template <typename S>
+    friend node_handle<S> readTree(std::istream&);
+  
   private:
-
+    
     // Determine whether a node is a leaf
     bool isLeaf(void) const;
+    // Recompute the cached summary from the children of an internal node
+    void updateSummary(void);
+    
+    // Helpers for concatBalanced
+    // Get the depth of the given subtree, where an empty subtree has depth -1
+    static long depthOf(const handle& n);
+    // Get the given subtree without internal nodes lacking a right child at its root,
+    //   or null if the subtree is empty
+    static handle trimmed(const handle& n);
+    // Rotate the given internal node (a (b c)) to ((a b) c), or ((a b) c) to (a (b c))
+    static handle rotateLeft(const handle& n);
+    static handle rotateRight(const handle& n);
+    // Concatenate the given subtrees, where the left subtree is more than one level
+    //   deeper than the right, or the right more than one level deeper than the left
+    static handle joinRight(const handle& l, const handle& r);
+    static handle joinLeft(const handle& l, const handle& r);
     
     size_t weight_;
+    size_t utf16Weight_;
+    size_t lineWeight_;
+    size_t depth_;
     handle left_;
     handle right_;
     string fragment_;
+  
+  }; // class basic_rope_node
+  
+  using rope_node = basic_rope_node<no_summary>;
+  
+  // Construct internal node by concatenating the given nodes
+  template <typename Summary>
+  basic_rope_node<Summary>::basic_rope_node(handle l, handle r)
+    : fragment_("")
+  {
+    this->left_ = std::move(l);
+    this->right_ = std::move(r);
+    this->weight_ = this->left_->getLength();
+    this->utf16Weight_ = this->left_->getUtf16Length();
+    this->lineWeight_ = this->left_->getNewlineCount();
+    size_t rDepth = (this->right_ == nullptr) ? 0 : this->right_->depth_;
+    this->depth_ = 1 + std::max(this->left_->depth_, rDepth);
+    this->updateSummary();
+    PROJ_TRACE_ALLOC(sizeof(basic_rope_node));
+  }
+  
+  // Construct leaf node from the given string
+  template <typename Summary>
+  basic_rope_node<Summary>::basic_rope_node(const std::string& str)
+    : weight_(str.length()),
+      utf16Weight_(countUtf16(str, 0, str.length())),
+      lineWeight_(countNewlines(str, 0, str.length())),
+      depth_(0), left_(nullptr), right_(nullptr), fragment_(str)
+  {
+    this->setStoredSummary(Summary(str));
+    PROJ_TRACE_ALLOC(sizeof(basic_rope_node) + str.length());
+  }
+  
+  // Construct leaf node from the given string, taking its buffer
+  template <typename Summary>
+  basic_rope_node<Summary>::basic_rope_node(std::string&& str)
+    : weight_(str.length()),
+      utf16Weight_(countUtf16(str, 0, str.length())),
+      lineWeight_(countNewlines(str, 0, str.length())),
+      depth_(0), left_(nullptr), right_(nullptr), fragment_(std::move(str))
+  {
+    this->setStoredSummary(Summary(this->fragment_));
+    PROJ_TRACE_ALLOC(sizeof(basic_rope_node) + this->fragment_.length());
+  }
+  
+  // Destructor
+  //
+  // Releasing a handle to the last reference of an internal node would destroy its
+  //   children recursively, overflowing the stack on a long chain of appends. So the
+  //   outermost destructor on a thread releases the internal children in turn from a
+  //   list, and the destructors this runs move their own internal children onto the
+  //   list rather than releasing them, leaving nothing to recurse over. Only the node
+  //   being destroyed is changed, and whether a child is destroyed is left to its
+  //   reference count, so a node still reachable from another thread is never
+  //   touched.
+  template <typename Summary>
+  basic_rope_node<Summary>::~basic_rope_node(void) {
+    // the list of the destructor draining on this thread, if any
+    static thread_local std::vector<handle> * draining = nullptr;
+    bool internalLeft = this->left_ != nullptr && !this->left_->isLeaf();
+    bool internalRight = this->right_ != nullptr && !this->right_->isLeaf();
+    if (!internalLeft && !internalRight) return;
+    if (draining != nullptr) {
+      if (internalLeft) draining->push_back(std::move(this->left_));
+      if (internalRight) draining->push_back(std::move(this->right_));
+      return;
+    }
+    std::vector<handle> pending;
+    if (internalLeft) pending.push_back(std::move(this->left_));
+    if (internalRight) pending.push_back(std::move(this->right_));
+    draining = &pending;
+    while (!pending.empty()) {
+      handle n = std::move(pending.back());
+      pending.pop_back();
+      n.reset();
+    }
+    draining = nullptr;
+  }
+  
+  // Determine whether a node is a leaf
+  template <typename Summary>
+  bool basic_rope_node<Summary>::isLeaf(void) const {
+    return this->left_ == nullptr && this->right_ == nullptr;
+  }
+  
+  // Recompute the cached summary from the children of an internal node
+  template <typename Summary>
+  void basic_rope_node<Summary>::updateSummary(void) {
+    if(this->right_ == nullptr) {
+      this->setStoredSummary(this->left_->getSummary());
+    } else {
+      this->setStoredSummary(this->left_->getSummary() + this->right_->getSummary());
+    }
+  }
+  
+  // Get string length by adding the weight of the root and all nodes in
+  //   path to rightmost child
+  template <typename Summary>
+  size_t basic_rope_node<Summary>::getLength() const {
+    if(this->isLeaf())
+      return this->weight_;
+    size_t tmp = (this->right_ == nullptr) ? 0 : this->right_->getLength();
+    return this->weight_ + tmp;
+  }
+  
+  // Get UTF-16 length by adding the UTF-16 weight of the root and all nodes in
+  //   path to rightmost child
+  template <typename Summary>
+  size_t basic_rope_node<Summary>::getUtf16Length() const {
+    if(this->isLeaf())
+      return this->utf16Weight_;
+    size_t tmp = (this->right_ == nullptr) ? 0 : this->right_->getUtf16Length();
+    return this->utf16Weight_ + tmp;
+  }
+  
+  // Get newline count by adding the line weight of the root and all nodes in
+  //   path to rightmost child
+  template <typename Summary>
+  size_t basic_rope_node<Summary>::getNewlineCount() const {
+    if(this->isLeaf())
+      return this->lineWeight_;
+    size_t tmp = (this->right_ == nullptr) ? 0 : this->right_->getNewlineCount();
+    return this->lineWeight_ + tmp;
+  }
+  
+  // Get the character at the given index
+  template <typename Summary>
+  char basic_rope_node<Summary>::getCharByIndex(size_t index) const {
+    size_t w = this->weight_;
+    // if node is a leaf, return the character at the specified index
+    if (this->isLeaf()) {
+      if (index >= this->weight_) {
+        throw ERROR_OOB_NODE;
+      } else {
+        return this->fragment_[index];
+      }
+    // else search the appropriate child node
+    } else {
+      if (index < w) {
+        return this->left_->getCharByIndex(index);
+      } else {
+        return this->right_->getCharByIndex(index - w);
+      }
+    }
+  }
+  
+  // Get the substring of (len) chars beginning at index (start)
+  template <typename Summary>
+  string basic_rope_node<Summary>::getSubstring(size_t start, size_t len) const {
+    PROJ_TRACE_SPAN("getSubstring", len);
+    string result(len, '\0');
+    this->copyRangeTo(start, len, &result[0]);
+    return result;
+  }
+  
+  // Get string contained in current node and its children
+  template <typename Summary>
+  string basic_rope_node<Summary>::treeToString(void) const {
+    PROJ_TRACE_SPAN("treeToString", this->getLength());
+    if(this->isLeaf()) {
+      return this->fragment_;
+    }
+    string result(this->getLength(), '\0');
+    this->copyTo(&result[0]);
+    return result;
+  }
+  
+  // Copy the string contained in current node and its children to the given buffer
+  //   Each fragment is copied once, directly into its final position
+  template <typename Summary>
+  void basic_rope_node<Summary>::copyTo(char * dst) const {
+    if(this->isLeaf()) {
+      std::copy(this->fragment_.begin(), this->fragment_.end(), dst);
+      return;
+    }
+    if (this->left_ != nullptr) this->left_->copyTo(dst);
+    if (this->right_ != nullptr) this->right_->copyTo(dst + this->weight_);
+  }
+  
+  // Copy the (len) chars beginning at index (start) to the given buffer
+  template <typename Summary>
+  void basic_rope_node<Summary>::copyRangeTo(size_t start, size_t len, char * dst) const {
+    if (len == 0) return;
+    if(this->isLeaf()) {
+      if (start + len > this->weight_) throw ERROR_OOB_NODE;
+      std::copy(this->fragment_.begin() + start, this->fragment_.begin() + start + len, dst);
+      return;
+    }
+    size_t w = this->weight_;
+    if (start < w) {
+      size_t lLen = std::min(len, w - start);
+      this->left_->copyRangeTo(start, lLen, dst);
+      if (len > lLen) {
+        if (this->right_ == nullptr) throw ERROR_OOB_NODE;
+        this->right_->copyRangeTo(0, len - lLen, dst + lLen);
+      }
+    } else {
+      if (this->right_ == nullptr) throw ERROR_OOB_NODE;
+      this->right_->copyRangeTo(start - w, len, dst);
+    }
+  }
+  
+  // Get the byte index of the code point containing the given UTF-16 offset
+  //   An offset equal to the UTF-16 length maps to the end of the string
+  template <typename Summary>
+  size_t basic_rope_node<Summary>::getByteByUtf16(size_t units) const {
+    if (this->isLeaf()) {
+      if (units > this->utf16Weight_) throw ERROR_OOB_NODE;
+      size_t i = 0;
+      // advance over every code point which ends at or before the target offset
+      while (i < this->weight_) {
+        size_t u = utf16Units(this->fragment_[i]);
+        if (u > units) break;
+        units -= u;
+        i++;
+        // skip continuation bytes belonging to the code point just consumed
+        while (i < this->weight_ && utf16Units(this->fragment_[i]) == 0) i++;
+      }
+      return i;
+    }
+    if (units < this->utf16Weight_ || this->right_ == nullptr) {
+      return this->left_->getByteByUtf16(units);
+    }
+    return this->weight_ + this->right_->getByteByUtf16(units - this->utf16Weight_);
+  }
+  
+  // Get the number of UTF-16 code units encoding the bytes before the given index
+  template <typename Summary>
+  size_t basic_rope_node<Summary>::getUtf16ByByte(size_t index) const {
+    if (this->isLeaf()) {
+      if (index > this->weight_) throw ERROR_OOB_NODE;
+      return countUtf16(this->fragment_, 0, index);
+    }
+    if (index < this->weight_ || this->right_ == nullptr) {
+      return this->left_->getUtf16ByByte(index);
+    }
+    return this->utf16Weight_ + this->right_->getUtf16ByByte(index - this->weight_);
+  }
+  
+  // Get the byte index immediately following the nth newline, where n >= 1
+  template <typename Summary>
+  size_t basic_rope_node<Summary>::getByteByNewline(size_t n) const {
+    if (this->isLeaf()) {
+      if (n == 0 || n > this->lineWeight_) throw ERROR_OOB_NODE;
+      size_t i = 0;
+      for (; n > 0; i++) {
+        if (this->fragment_[i] == '\n') n--;
+      }
+      return i;
+    }
+    if (n <= this->lineWeight_ || this->right_ == nullptr) {
+      return this->left_->getByteByNewline(n);
+    }
+    return this->weight_ + this->right_->getByteByNewline(n - this->lineWeight_);
+  }
+  
+  // Get the number of newline characters before the given byte index
+  template <typename Summary>
+  size_t basic_rope_node<Summary>::getNewlinesByByte(size_t index) const {
+    if (this->isLeaf()) {
+      if (index > this->weight_) throw ERROR_OOB_NODE;
+      return countNewlines(this->fragment_, 0, index);
+    }
+    if (index < this->weight_ || this->right_ == nullptr) {
+      return this->left_->getNewlinesByByte(index);
+    }
+    return this->lineWeight_ + this->right_->getNewlinesByByte(index - this->weight_);
+  }
+  
+  // Get the summary of the string contained in current node and its children
+  template <typename Summary>
+  const Summary& basic_rope_node<Summary>::getSummary(void) const {
+    return this->getStoredSummary();
+  }
+  
+  // Get the summary of the first (index) chars by combining the summaries of the
+  //   left subtrees passed over on the way down to the leaf containing the index
+  template <typename Summary>
+  Summary basic_rope_node<Summary>::getPrefixSummary(size_t index) const {
+    if (this->isLeaf()) {
+      if (index > this->weight_) throw ERROR_OOB_NODE;
+      return Summary(this->fragment_.substr(0, index));
+    }
+    if (index < this->weight_ || this->right_ == nullptr) {
+      return this->left_->getPrefixSummary(index);
+    }
+    return this->left_->getSummary() + this->right_->getPrefixSummary(index - this->weight_);
+  }
+  
+  // Get the length of the shortest prefix whose summary satisfies the predicate
+  //
+  // The predicate must be monotone: once satisfied by a prefix, it must be satisfied
+  //   by every longer prefix. Whole subtrees are skipped whenever the predicate does
+  //   not hold for the summaries passed over, so only the leaf containing the answer
+  //   is examined character by character.
+  template <typename Summary>
+  template <typename Pred>
+  size_t basic_rope_node<Summary>::seek(Pred& pred, Summary& acc) const {
+    if (this->isLeaf()) {
+      // a single buffer holds each char in turn, rather than a new string per char
+      string c(1, '\0');
+      for (size_t i = 0; i < this->weight_; i++) {
+        c[0] = this->fragment_[i];
+        acc = acc + Summary(c);
+        if (pred(acc)) return i + 1;
+      }
+      return string::npos;
+    }
+    Summary withLeft = acc + this->left_->getSummary();
+    if (pred(withLeft) || this->right_ == nullptr) {
+      return this->left_->seek(pred, acc);
+    }
+    acc = withLeft;
+    size_t result = this->right_->seek(pred, acc);
+    return (result == string::npos) ? result : this->weight_ + result;
+  }
+  
+  // Split the represented string at the specified index
+  //
+  // Only the nodes on the path from the given node to the split index are rebuilt;
+  //   all other subtrees are shared between the given node and the result.
+  template <typename Summary>
+  std::pair<node_handle<Summary>, node_handle<Summary>> splitAt(const node_handle<Summary>& node, size_t index)
+  {
+    using handle = node_handle<Summary>;
+    using std::make_shared;
+    using std::pair;
+    
+    size_t w = node->weight_;
+    // if the given node is a leaf, split the leaf
+    if(node->isLeaf()) {
+      if (index == 0 && w > 0) {
+        return pair<handle,handle>{ make_shared<const basic_rope_node<Summary>>(""), node };
+      } else if (index == w) {
+        return pair<handle,handle>{ node, make_shared<const basic_rope_node<Summary>>("") };
+      }
+      return pair<handle,handle>{
+        make_shared<const basic_rope_node<Summary>>(node->fragment_.substr(0,index)),
+        make_shared<const basic_rope_node<Summary>>(node->fragment_.substr(index,w-index))
+      };
+    }
+    
+    if (node->right_ == nullptr) {
+      return splitAt(node->left_, index);
+    }
+    
+    // if the given node is a concat (internal) node, compare index to weight and handle
+    //   accordingly
+    if (index < w) {
+      pair<handle, handle> splitLeftResult = splitAt(node->left_, index);
+      return pair<handle,handle>{
+        splitLeftResult.first,
+        make_shared<const basic_rope_node<Summary>>(splitLeftResult.second, node->right_)
+      };
+    } else if (w < index) {
+      pair<handle, handle> splitRightResult = splitAt(node->right_, index-w);
+      return pair<handle,handle>{
+        make_shared<const basic_rope_node<Summary>>(node->left_, splitRightResult.first),
+        splitRightResult.second
+      };
+    } else {
+      return pair<handle,handle>{ node->left_, node->right_ };
+    }
+  }
+  
+  // Concatenate the given subtrees, rebalancing along the spine of the deeper one
+  //
+  // Subtrees whose depths differ by at most one are joined beneath a new root.
+  //   Otherwise the shallower subtree is joined to the node on the facing spine of
+  //   the deeper subtree which has about the same depth, and the nodes above it are
+  //   rebuilt, rotating wherever the depths of siblings would differ by more than one.
+  //   Only O(|depth(l) - depth(r)|) nodes are built.
+  //
+  // When both subtrees satisfy the AVL condition (the children of every node differ
+  //   in depth by at most one) so does the result. Since an AVL tree of depth d has
+  //   at least fib(d+2) leaves, such a tree also satisfies isBalanced.
+  template <typename Summary>
+  node_handle<Summary> concatBalanced(const node_handle<Summary>& l, const node_handle<Summary>& r)
+  {
+    using node = basic_rope_node<Summary>;
+    node_handle<Summary> lt = node::trimmed(l), rt = node::trimmed(r);
+    if (lt == nullptr) return (rt == nullptr) ? l : rt;
+    if (rt == nullptr) return lt;
+    long ld = node::depthOf(lt), rd = node::depthOf(rt);
+    if (ld > rd + 1) return node::joinRight(lt, rt);
+    if (rd > ld + 1) return node::joinLeft(lt, rt);
+    return std::make_shared<const node>(lt, rt);
+  }
+  
+  // Split the represented string at the specified index
+  //
+  // The subtrees hanging off either side of the path to the index are rejoined with
+  //   concatBalanced as the recursion unwinds, so that splitting an AVL tree yields
+  //   two AVL trees in O(log n) time. An empty side is returned as a null handle, and
+  //   a null handle may be split as the empty string.
+  template <typename Summary>
+  std::pair<node_handle<Summary>, node_handle<Summary>> splitBalanced(const node_handle<Summary>& node, size_t index)
+  {
+    using handle = node_handle<Summary>;
+    using std::make_shared;
+    using std::pair;
+    
+    if (node == nullptr) return pair<handle,handle>{ nullptr, nullptr };
+    size_t w = node->weight_;
+    if(node->isLeaf()) {
+      if (index == 0) return pair<handle,handle>{ nullptr, node };
+      if (index >= w) return pair<handle,handle>{ node, nullptr };
+      return pair<handle,handle>{
+        make_shared<const basic_rope_node<Summary>>(node->fragment_.substr(0,index)),
+        make_shared<const basic_rope_node<Summary>>(node->fragment_.substr(index,w-index))
+      };
+    }
+    
+    if (node->right_ == nullptr) {
+      return splitBalanced(node->left_, index);
+    }
     
-  }; // class rope_node
+    if (index < w) {
+      pair<handle, handle> splitLeftResult = splitBalanced(node->left_, index);
+      return pair<handle,handle>{
+        splitLeftResult.first,
+        concatBalanced(splitLeftResult.second, node->right_)
+      };
+    } else if (w < index) {
+      pair<handle, handle> splitRightResult = splitBalanced(node->right_, index-w);
+      return pair<handle,handle>{
+        concatBalanced(node->left_, splitRightResult.first),
+        splitRightResult.second
+      };
+    } else {
+      return pair<handle,handle>{ node->left_, node->right_ };
+    }
+  }
+  
+  // Rebalance the subtrees of the given node which fail the given balance condition
+  //
+  // A subtree satisfying balanced(n) is kept as it is, so when an edit has unbalanced
+  //   an otherwise balanced tree only the nodes on the edited paths are examined. The
+  //   children of an unbalanced node are rebalanced first and rejoined with
+  //   concatBalanced, which rotates along the spine of the deeper child; only if the
+  //   join still fails the condition is the subtree passed to rebuild(n), which
+  //   rebuilds it from its leaves. A subtree failing repairable(n), being too far
+  //   out of balance for the recursion to descend (as after a long run of appends),
+  //   instead has its largest balanced subtrees joined in order without recursing,
+  //   so that a chain over a balanced subtree costs time in proportion to the chain
+  //   rather than to the whole subtree. Returns null for an empty subtree.
+  template <typename Summary, typename Pred, typename Repairable, typename Rebuild>
+  node_handle<Summary> rebalanceLocal(const node_handle<Summary>& node, const Pred& balanced,
+    const Repairable& repairable, const Rebuild& rebuild)
+  {
+    if (node == nullptr || node->isLeaf() || balanced(node)) return basic_rope_node<Summary>::trimmed(node);
+    if (!repairable(node)) {
+      // runs of leaves between the balanced subtrees are built into minimal trees first
+      node_handle<Summary> joined;
+      std::vector<node_handle<Summary>> run;
+      auto flush = [&](void) {
+        if (run.empty()) return;
+        joined = concatBalanced(joined, buildTree(run.data(), run.data() + run.size()));
+        run.clear();
+      };
+      std::vector<const node_handle<Summary> *> pending{&node};
+      while (!pending.empty()) {
+        const node_handle<Summary>& n = *pending.back();
+        pending.pop_back();
+        if (n == nullptr) continue;
+        if (n->isLeaf()) {
+          if (n->getLength() > 0) run.push_back(n);
+        } else if (balanced(n)) {
+          flush();
+          joined = concatBalanced(joined, n);
+        } else {
+          pending.push_back(&n->right_);
+          pending.push_back(&n->left_);
+        }
+      }
+      flush();
+      if (joined == nullptr || balanced(joined)) return joined;
+      return rebuild(joined);
+    }
+    node_handle<Summary> joined = concatBalanced(rebalanceLocal(node->left_, balanced, repairable, rebuild),
+                                                 rebalanceLocal(node->right_, balanced, repairable, rebuild));
+    if (joined == nullptr || balanced(joined)) return joined;
+    return rebuild(joined);
+  }
+  
+  // Get the depth of the given subtree, where an empty subtree has depth -1
+  template <typename Summary>
+  long basic_rope_node<Summary>::depthOf(const handle& n) {
+    return (n == nullptr) ? -1 : static_cast<long>(n->depth_);
+  }
+  
+  // Get the given subtree without internal nodes lacking a right child at its root,
+  //   or null if the subtree is empty
+  template <typename Summary>
+  node_handle<Summary> basic_rope_node<Summary>::trimmed(const handle& n) {
+    const handle * t = &n;
+    while (*t != nullptr && !(*t)->isLeaf() && (*t)->right_ == nullptr) t = &(*t)->left_;
+    if (*t == nullptr || (*t)->getLength() == 0) return nullptr;
+    return *t;
+  }
+  
+  // Rotate the given internal node (a (b c)) to ((a b) c)
+  template <typename Summary>
+  node_handle<Summary> basic_rope_node<Summary>::rotateLeft(const handle& n) {
+    handle r = trimmed(n->right_);
+    handle l = std::make_shared<const basic_rope_node>(n->left_, r->left_);
+    return std::make_shared<const basic_rope_node>(l, r->right_);
+  }
+  
+  // Rotate the given internal node ((a b) c) to (a (b c))
+  template <typename Summary>
+  node_handle<Summary> basic_rope_node<Summary>::rotateRight(const handle& n) {
+    handle l = trimmed(n->left_);
+    handle r = std::make_shared<const basic_rope_node>(l->right_, n->right_);
+    return std::make_shared<const basic_rope_node>(l->left_, r);
+  }
+  
+  // Concatenate the given subtrees, where the left subtree is more than one level
+  //   deeper than the right, by descending the right spine of the left subtree
+  template <typename Summary>
+  node_handle<Summary> basic_rope_node<Summary>::joinRight(const handle& l, const handle& r) {
+    handle a = trimmed(l->left_), c = trimmed(l->right_);
+    if (a == nullptr) return concatBalanced(c, r);
+    if (c == nullptr) return concatBalanced(a, r);
+    if (depthOf(c) <= depthOf(r) + 1) {
+      handle t = std::make_shared<const basic_rope_node>(c, r);
+      if (depthOf(t) <= depthOf(a) + 1) return std::make_shared<const basic_rope_node>(a, t);
+      return rotateLeft(std::make_shared<const basic_rope_node>(a, rotateRight(t)));
+    }
+    handle t = joinRight(c, r);
+    handle result = std::make_shared<const basic_rope_node>(a, t);
+    return (depthOf(t) <= depthOf(a) + 1) ? result : rotateLeft(result);
+  }
   
+  // Concatenate the given subtrees, where the right subtree is more than one level
+  //   deeper than the left, by descending the left spine of the right subtree
+  template <typename Summary>
+  node_handle<Summary> basic_rope_node<Summary>::joinLeft(const handle& l, const handle& r) {
+    handle a = trimmed(r->left_), c = trimmed(r->right_);
+    if (c == nullptr) return concatBalanced(l, a);
+    if (a == nullptr) return concatBalanced(l, c);
+    if (depthOf(a) <= depthOf(l) + 1) {
+      handle t = std::make_shared<const basic_rope_node>(l, a);
+      if (depthOf(t) <= depthOf(c) + 1) return std::make_shared<const basic_rope_node>(t, c);
+      return rotateRight(std::make_shared<const basic_rope_node>(rotateLeft(t), c));
+    }
+    handle t = joinLeft(l, a);
+    handle result = std::make_shared<const basic_rope_node>(t, c);
+    return (depthOf(t) <= depthOf(c) + 1) ? result : rotateRight(result);
+  }
+  
+  // Apply the given sorted, non-overlapping edits to the subtree representing the
+  //   chars beginning at index (lo), where (last) indicates that the subtree ends the
+  //   string
+  //
+  // Offsets of edits are relative to the unedited string. An edit is passed to every
+  //   subtree its deleted range overlaps, but its text is inserted only into the
+  //   subtree containing its offset (or into the final subtree, for an offset at the
+  //   end of the string). Subtrees which no edit touches are reused untouched, so each
+  //   node on the paths to the edited positions is visited exactly once.
+  template <typename Summary>
+  node_handle<Summary> applyEditsAt(const node_handle<Summary>& node,
+    size_t lo, bool last, const rope_edit * begin, const rope_edit * end)
+  {
+    using std::make_shared;
+    
+    if (begin == end) return node;
+    
+    // if the given node is a leaf, rebuild its fragment with the edits applied
+    if(node->isLeaf()) {
+      size_t hi = lo + node->weight_;
+      string result;
+      size_t pos = lo;
+      for (const rope_edit * e = begin; e != end; e++) {
+        size_t start = std::max(e->offset, lo);
+        result.append(node->fragment_, pos - lo, start - pos);
+        if (e->offset >= lo && (e->offset < hi || last)) result.append(e->insertText);
+        pos = std::max(pos, std::min(e->offset + e->deleteLen, hi));
+      }
+      result.append(node->fragment_, pos - lo, hi - pos);
+      return make_shared<const basic_rope_node<Summary>>(result);
+    }
+    
+    if (node->right_ == nullptr) {
+      return applyEditsAt(node->left_, lo, last, begin, end);
+    }
+    
+    // partition the edits between the children: the left child receives every edit
+    //   beginning within it, and the right child every edit ending beyond it
+    size_t mid = lo + node->weight_;
+    const rope_edit * leftEnd = begin;
+    while (leftEnd != end && leftEnd->offset < mid) leftEnd++;
+    const rope_edit * rightBegin = leftEnd;
+    if (rightBegin != begin) {
+      const rope_edit * prev = rightBegin - 1;
+      if (prev->offset + prev->deleteLen > mid) rightBegin = prev;
+    }
+    
+    return make_shared<const basic_rope_node<Summary>>(
+      applyEditsAt(node->left_, lo, false, begin, leftEnd),
+      applyEditsAt(node->right_, mid, last, rightBegin, end)
+    );
+  }
+  
+  // Concatenate the nodes in [begin, end) into a tree of minimal depth
+  template <typename Summary>
+  node_handle<Summary> buildTree(const node_handle<Summary> * begin, const node_handle<Summary> * end)
+  {
+    if (end - begin == 1) return *begin;
+    auto mid = begin + (end - begin) / 2;
+    return std::make_shared<const basic_rope_node<Summary>>(buildTree(begin, mid), buildTree(mid, end));
+  }
+  
+  // Concatenate the nodes in [begin, end) into a tree of minimal depth on the given
+  //   pool, producing the same tree as buildTree
+  //
+  // The halves of every range of more than (grain) nodes are built as separate
+  //   tasks, so idle threads steal the largest remaining ranges first.
+  template <typename Summary>
+  node_handle<Summary> buildTreeParallel(const node_handle<Summary> * begin,
+    const node_handle<Summary> * end, size_t grain, task_pool& pool)
+  {
+    if (size_t(end - begin) <= std::max(grain, size_t(1))) return buildTree(begin, end);
+    auto mid = begin + (end - begin) / 2;
+    node_handle<Summary> l, r;
+    pool.invoke([&] { l = buildTreeParallel(begin, mid, grain, pool); },
+                [&] { r = buildTreeParallel(mid, end, grain, pool); });
+    return std::make_shared<const basic_rope_node<Summary>>(std::move(l), std::move(r));
+  }
+  
+  // Insert the given subtree at each of the given sorted indices of the subtree
+  //   representing the chars beginning at index (lo), where (last) indicates that the
+  //   subtree ends the string
+  //
+  // Indices are relative to the string before any insertion. As with applyEditsAt,
+  //   untouched subtrees are reused and every touched leaf is split only once,
+  //   however many insertions it receives. The inserted subtree itself is shared by
+  //   every position rather than copied.
+  template <typename Summary>
+  node_handle<Summary> insertAllAt(const node_handle<Summary>& node,
+    size_t lo, bool last, const size_t * begin, const size_t * end, const node_handle<Summary>& text)
+  {
+    using handle = node_handle<Summary>;
+    using std::make_shared;
+    
+    if (begin == end) return node;
+    
+    // if the given node is a leaf, split it at every index and interleave the copies
+    if(node->isLeaf()) {
+      std::vector<handle> pieces;
+      size_t pos = 0;
+      for (const size_t * i = begin; i != end; i++) {
+        size_t index = *i - lo;
+        if (index > pos) {
+          pieces.push_back(make_shared<const basic_rope_node<Summary>>(node->fragment_.substr(pos, index - pos)));
+        }
+        pieces.push_back(text);
+        pos = index;
+      }
+      if (pos < node->weight_ || pieces.empty()) {
+        pieces.push_back(make_shared<const basic_rope_node<Summary>>(node->fragment_.substr(pos)));
+      }
+      return buildTree(pieces.data(), pieces.data() + pieces.size());
+    }
+    
+    if (node->right_ == nullptr) {
+      return insertAllAt(node->left_, lo, last, begin, end, text);
+    }
+    
+    // partition the indices between the children, passing indices on the boundary
+    //   to the right child
+    size_t mid = lo + node->weight_;
+    const size_t * split = std::lower_bound(begin, end, mid);
+    return make_shared<const basic_rope_node<Summary>>(
+      insertAllAt(node->left_, lo, false, begin, split, text),
+      insertAllAt(node->right_, mid, last, split, end, text)
+    );
+  }
+  
+  // Get the maximum depth of the rope, where the depth of a leaf is 0 and the
+  //   depth of an internal node is 1 plus the max depth of its children
+  template <typename Summary>
+  size_t basic_rope_node<Summary>::getDepth(void) const {
+    return this->depth_;
+  }
+  
+  // Store all leaves of the given node in the given vector
+  template <typename Summary>
+  void getLeaves(const node_handle<Summary>& node, std::vector<node_handle<Summary>>& v) {
+    // walk the tree with an explicit stack, so that chains of any depth are handled
+    std::vector<const node_handle<Summary> *> pending(1, &node);
+    while (!pending.empty()) {
+      const node_handle<Summary>& n = *pending.back();
+      pending.pop_back();
+      if (n->isLeaf()) {
+        v.push_back(n);
+        continue;
+      }
+      if (n->right_ != nullptr) pending.push_back(&n->right_);
+      if (n->left_ != nullptr) pending.push_back(&n->left_);
+    }
+  }
+  
+  // Reduce the subtree of the given node, whose string begins at index (offset), to a
+  //   single value on the given pool
+  //
+  // leaf(n, offset) computes the value of a subtree n of at most (grain) chars, or of
+  //   a leaf, whose string begins at (offset); combine(l, r) joins the values of
+  //   adjacent subtrees in string order. Where both children of a node are longer
+  //   than the grain they are reduced as separate tasks, so rope operations which
+  //   divide and conquer over the tree need only supply these two functions.
+  //
+  // Where only one child is longer than the grain, the other is reduced directly and
+  //   the longer child is descended iteratively, so that long chains of appends do
+  //   not nest tasks to the depth of the chain.
+  template <typename T, typename Summary, typename Leaf, typename Combine>
+  T parallelReduce(const node_handle<Summary>& node, size_t offset, size_t grain,
+    task_pool& pool, const Leaf& leaf, const Combine& combine)
+  {
+    // values of the short children passed over, and whether each precedes the rest
+    std::vector<std::pair<bool, T>> passed;
+    const node_handle<Summary> * n = &node;
+    T result;
+    while (true) {
+      const basic_rope_node<Summary>& cur = **n;
+      if (cur.isLeaf() || cur.getLength() <= grain) {
+        result = leaf(*n, offset);
+        break;
+      }
+      if (cur.right_ == nullptr) {
+        n = &cur.left_;
+      } else if (cur.right_->getLength() <= grain) {
+        passed.push_back(std::make_pair(false, leaf(cur.right_, offset + cur.weight_)));
+        n = &cur.left_;
+      } else if (cur.weight_ <= grain) {
+        passed.push_back(std::make_pair(true, leaf(cur.left_, offset)));
+        offset += cur.weight_;
+        n = &cur.right_;
+      } else {
+        T l, r;
+        pool.invoke([&] { l = parallelReduce<T>(cur.left_, offset, grain, pool, leaf, combine); },
+                    [&] { r = parallelReduce<T>(cur.right_, offset + cur.weight_, grain, pool, leaf, combine); });
+        result = combine(std::move(l), std::move(r));
+        break;
+      }
+    }
+    for (auto it = passed.rbegin(); it != passed.rend(); ++it) {
+      result = it->first ? combine(std::move(it->second), std::move(result))
+                         : combine(std::move(result), std::move(it->second));
+    }
+    return result;
+  }
+  
+  // An allocator which records the size of each block it allocates, by which the
+  //   size of the block make_shared allocates for a node (the node together with its
+  //   reference counts) is measured rather than estimated
+  //
+  // The allocator holds no state, so the control block allocate_shared builds with
+  //   it is the same size as the one make_shared builds with std::allocator.
+  inline size_t& lastAllocatedBytes(void) {
+    static size_t bytes = 0;
+    return bytes;
+  }
+  
+  template <typename T>
+  struct size_recording_allocator {
+    using value_type = T;
+    size_recording_allocator(void) {}
+    template <typename U>
+    size_recording_allocator(const size_recording_allocator<U>&) {}
+    T * allocate(size_t n) {
+      lastAllocatedBytes() = n * sizeof(T);
+      return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T * p, size_t n) {
+      std::allocator<T>().deallocate(p, n);
+    }
+    template <typename U>
+    bool operator==(const size_recording_allocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const size_recording_allocator<U>&) const { return false; }
+  };
+  
+  // Get the size of the block allocated for a node by make_shared, excluding the
+  //   text of a leaf and the bookkeeping of the heap allocator itself
+  template <typename Summary>
+  size_t sharedNodeBytes(void) {
+    static const size_t bytes = [](void) {
+      std::allocate_shared<basic_rope_node<Summary>>(
+        size_recording_allocator<basic_rope_node<Summary>>(), string());
+      return lastAllocatedBytes();
+    }();
+    return bytes;
+  }
+  
+  // Get the approximate number of bytes occupied by the node and every descendant
+  //   which is not shared with another node
+  //
+  // A child is counted only while its parent holds the sole reference to it, so the
+  //   result excludes every subtree that is also part of another rope (or another
+  //   version of the same rope). The tree is walked with an explicit stack, as in
+  //   getStats, so that the walk of a long chain cannot exhaust the call stack.
+  template <typename Summary>
+  size_t basic_rope_node<Summary>::getUnsharedBytes(void) const {
+    size_t bytes = 0;
+    std::vector<const basic_rope_node *> pending{this};
+    while (!pending.empty()) {
+      const basic_rope_node * n = pending.back();
+      pending.pop_back();
+      // account for the reference counts allocated alongside every node
+      bytes += sharedNodeBytes<Summary>() + n->fragment_.capacity();
+      if (n->left_ != nullptr && n->left_.use_count() == 1) pending.push_back(n->left_.get());
+      if (n->right_ != nullptr && n->right_.use_count() == 1) pending.push_back(n->right_.get());
+    }
+    return bytes;
+  }
+  
+  // Get the structural statistics of the given subtree
+  //
+  // The tree is walked once, with an explicit stack so that the walk of a long chain
+  //   cannot exhaust the call stack. A node is counted as shared if the handle by
+  //   which it was reached, or that of any of its ancestors, has other owners.
+  template <typename Summary>
+  rope_stats getStats(const node_handle<Summary>& root)
+  {
+    rope_stats stats = { 0, 0, 0, 0, std::vector<size_t>(), 0, 0, 0 };
+    if (root == nullptr) return stats;
+    stats.depth = root->depth_;
+    // pending handles, each paired with whether an ancestor is shared
+    std::vector<std::pair<const node_handle<Summary> *, bool>> pending;
+    pending.emplace_back(&root, false);
+    while (!pending.empty()) {
+      const node_handle<Summary> & n = *pending.back().first;
+      bool shared = pending.back().second || n.use_count() > 1;
+      pending.pop_back();
+      stats.nodes++;
+      stats.overheadBytes += sharedNodeBytes<Summary>();
+      if (shared) stats.sharedNodes++;
+      if (n->isLeaf()) {
+        size_t len = n->weight_;
+        stats.leaves++;
+        stats.textBytes += len;
+        if (len == 0) {
+          stats.emptyLeaves++;
+          continue;
+        }
+        size_t bucket = 0;
+        while (len >> (bucket + 1)) bucket++;
+        if (stats.leafSizes.size() <= bucket) stats.leafSizes.resize(bucket + 1);
+        stats.leafSizes[bucket]++;
+        continue;
+      }
+      if (n->right_ != nullptr) pending.emplace_back(&n->right_, shared);
+      if (n->left_ != nullptr) pending.emplace_back(&n->left_, shared);
+    }
+    return stats;
+  }
+  
+  // The serialized format
+  //
+  // All integers are 8 bytes, little-endian:
+  //   header: "PROJROPE" version node-count text-bytes
+  //   table:  an entry of four integers for each node, children before their
+  //           parents and the root last:
+  //             leaf:     offset of its text, length | LEAF_BIT, UTF-16 length,
+  //                       newline count
+  //             internal: index of left child, index of right child, 0, 0
+  //   text:   the text of every leaf, contiguously and in the order of the table
+  // Every node but the root is the child of exactly one other, so that the table is a
+  //   tree; a subtree shared within the rope is written once for each occurrence.
+  //   Every internal node has two children; one lacking a right child is written as
+  //   its left child.
+  const char SERIALIZED_MAGIC[] = "PROJROPE";
+  const uint64_t SERIALIZED_VERSION = 1;
+  const size_t SERIALIZED_HEADER_BYTES = 32;
+  const size_t SERIALIZED_ENTRY_BYTES = 32;
+  const uint64_t LEAF_BIT = uint64_t(1) << 63;
+  
+  // Write the given subtree to the stream in the format of basic_rope::serialize
+  //
+  // Nodes are numbered in post-order by a depth-first walk, so that the text of the
+  //   leaves is in order. The text is written straight from the leaves, without
+  //   gathering it first.
+  template <typename Summary>
+  void writeTree(const node_handle<Summary>& root, std::ostream& out)
+  {
+    using node = basic_rope_node<Summary>;
+    std::vector<const node *> leaves;
+    string table;
+    uint64_t count = 0, textBytes = 0;
+    // pending nodes, each paired with whether its children have been numbered, and
+    //   the numbers of the subtrees awaiting their parents
+    std::vector<std::pair<const node *, bool>> pending;
+    std::vector<uint64_t> numbered;
+    // a node lacking a right child is written as its left child
+    auto collapsed = [](const node * n) {
+      while (!n->isLeaf() && n->right_ == nullptr) n = n->left_.get();
+      return n;
+    };
+    if (root != nullptr) pending.emplace_back(collapsed(root.get()), false);
+    while (!pending.empty()) {
+      const node * n = pending.back().first;
+      bool childrenDone = pending.back().second;
+      pending.pop_back();
+      if (n->isLeaf()) {
+        putU64(table, textBytes);
+        putU64(table, n->weight_ | LEAF_BIT);
+        putU64(table, n->utf16Weight_);
+        putU64(table, n->lineWeight_);
+        textBytes += n->weight_;
+        leaves.push_back(n);
+      } else if (!childrenDone) {
+        pending.emplace_back(n, true);
+        pending.emplace_back(collapsed(n->right_.get()), false);
+        pending.emplace_back(collapsed(n->left_.get()), false);
+        continue;
+      } else {
+        uint64_t right = numbered.back();
+        numbered.pop_back();
+        putU64(table, numbered.back());
+        putU64(table, right);
+        putU64(table, 0);
+        putU64(table, 0);
+        numbered.pop_back();
+      }
+      numbered.push_back(count++);
+    }
+    
+    string header(SERIALIZED_MAGIC, sizeof(SERIALIZED_MAGIC) - 1);
+    putU64(header, SERIALIZED_VERSION);
+    putU64(header, count);
+    putU64(header, textBytes);
+    writeBytes(out, header);
+    writeBytes(out, table);
+    for (const node * leaf : leaves) writeBytes(out, leaf->fragment_);
+  }
+  
+  // Read a subtree written by writeTree, or null if it was empty
+  //
+  // The table is read in one piece, and every node is then built directly from its
+  //   entry, with each leaf reading its text straight into its own fragment, so that
+  //   no text is copied twice and nothing is split, rebalanced or searched. Entries
+  //   which would lack a child, refer forward, refer to a node already the child of
+  //   another, or refer out of order into the text are rejected, as are leaves whose
+  //   stored counts differ from those of their text, and tables which are not a
+  //   single tree over all of the text.
+  template <typename Summary>
+  node_handle<Summary> readTree(std::istream& in)
+  {
+    using node = basic_rope_node<Summary>;
+    string header = readExactly(in, SERIALIZED_HEADER_BYTES);
+    if (header.compare(0, sizeof(SERIALIZED_MAGIC) - 1, SERIALIZED_MAGIC) != 0 ||
+        getU64(&header[8]) != SERIALIZED_VERSION) {
+      throw ERROR_BAD_SERIALIZATION;
+    }
+    uint64_t count = getU64(&header[16]);
+    uint64_t textBytes = getU64(&header[24]);
+    if (count > (LEAF_BIT - 1) / SERIALIZED_ENTRY_BYTES) throw ERROR_BAD_SERIALIZATION;
+    string table = readExactly(in, count * SERIALIZED_ENTRY_BYTES);
+    
+    std::vector<node_handle<Summary>> nodes;
+    std::vector<bool> referenced(count, false);
+    nodes.reserve(count);
+    uint64_t offset = 0;
+    for (uint64_t i = 0; i < count; i++) {
+      const char * entry = &table[i * SERIALIZED_ENTRY_BYTES];
+      uint64_t a = getU64(entry), b = getU64(entry + 8);
+      if ((b & LEAF_BIT) != 0) {
+        uint64_t len = b & ~LEAF_BIT;
+        if (a != offset || len > textBytes - offset) throw ERROR_BAD_SERIALIZATION;
+        node_handle<Summary> leaf = std::make_shared<const node>(readExactly(in, len));
+        if (leaf->utf16Weight_ != getU64(entry + 16) || leaf->lineWeight_ != getU64(entry + 24)) {
+          throw ERROR_BAD_SERIALIZATION;
+        }
+        nodes.push_back(std::move(leaf));
+        offset += len;
+      } else {
+        if (a >= i || b >= i || a == b || referenced[a] || referenced[b]) throw ERROR_BAD_SERIALIZATION;
+        // the children are disjoint subtrees over the text, but check the sum anyway
+        if (nodes[a]->getLength() > (LEAF_BIT - 1) - nodes[b]->getLength()) throw ERROR_BAD_SERIALIZATION;
+        referenced[a] = true;
+        referenced[b] = true;
+        nodes.push_back(std::make_shared<const node>(nodes[a], nodes[b]));
+      }
+    }
+    // every node but the root is a child, and the root holds all of the text
+    if (offset != textBytes || std::count(referenced.begin(), referenced.end(), false) > 1 ||
+        (!nodes.empty() && nodes.back()->getLength() != textBytes)) {
+      throw ERROR_BAD_SERIALIZATION;
+    }
+    return nodes.empty() ? nullptr : nodes.back();
+  }
+  
+  extern template class basic_rope_node<no_summary>;
+
 } // namespace proj
@@ -0,0 +1,222 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "parallel.hpp"
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <iterator>
+
+namespace proj
+{
+  // Get the number of threads used by parallel operations when none is specified
+  size_t defaultThreadCount(void) {
+    size_t n = std::thread::hardware_concurrency();
+    return (n == 0) ? 1 : n;
+  }
+  
+  // A forked function, which is run by whichever thread first removes it from its
+  //   deque. The function belongs to the forking thread, which waits for it to finish
+  struct task_pool::task {
+    const std::function<void(void)> * fn;
+    std::atomic<bool> done;
+    std::exception_ptr error;
+    explicit task(const std::function<void(void)> * f) : fn(f), done(false) {}
+  };
+  
+  // A deque of tasks; a task is removed from its deque by the thread which runs it,
+  //   so that every queued task is still to be run
+  struct task_pool::task_queue {
+    std::mutex lock;
+    std::deque<std::shared_ptr<task_pool::task>> tasks;
+  };
+  
+  // The pool and deque belonging to the calling thread, if it is a worker
+  struct worker_identity {
+    const task_pool * pool;
+    size_t queue;
+  };
+  static thread_local worker_identity currentWorker = { nullptr, 0 };
+  
+  // Construct a pool of (threads) threads, counting the calling thread
+  task_pool::task_pool(size_t threads)
+    : queued_(0), stop_(false)
+  {
+    if (threads == 0) threads = 1;
+    // one deque per worker, and a final deque shared by threads outside the pool
+    for (size_t i = 0; i < threads; i++) this->queues_.emplace_back(new task_queue);
+    for (size_t i = 0; i + 1 < threads; i++) {
+      this->workers_.push_back(std::thread([this, i] { this->work(i); }));
+    }
+  }
+  
+  // Stop the worker threads
+  task_pool::~task_pool(void) {
+    {
+      std::lock_guard<std::mutex> hold(this->sleepLock_);
+      this->stop_ = true;
+    }
+    this->wake_.notify_all();
+    for (std::thread& t : this->workers_) t.join();
+  }
+  
+  // Get the number of threads which run tasks, counting the calling thread
+  size_t task_pool::threadCount(void) const {
+    return this->workers_.size() + 1;
+  }
+  
+  // Get the length of the pieces into which a parallel operation should divide a
+  //   string of (len) chars
+  //
+  // Each thread is offered several pieces, so that threads which finish early can
+  //   steal more, but no piece is so short that handing it over costs more than
+  //   processing it.
+  size_t task_pool::grainSize(size_t len) const {
+    return std::max(MIN_PARALLEL_GRAIN, len / (this->threadCount() * PIECES_PER_THREAD));
+  }
+  
+  // Get the pool used by parallel operations when none is specified
+  task_pool& task_pool::shared(void) {
+    static task_pool pool;
+    return pool;
+  }
+  
+  // Run both functions, possibly concurrently
+  //
+  // The second function is offered to other threads while the first runs on the
+  //   calling thread. If no other thread has taken it by then, the calling thread
+  //   takes it back and runs it too; otherwise the calling thread runs other tasks
+  //   until it is done, sleeping whenever there are none.
+  void task_pool::invoke(const std::function<void(void)>& a, const std::function<void(void)>& b) {
+    std::shared_ptr<task> t = std::make_shared<task>(&b);
+    size_t own = this->ownQueue();
+    bool queued = !this->workers_.empty();
+    if (queued) this->push(own, t);
+    std::exception_ptr error;
+    try {
+      a();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    
+    if (!queued || this->takeBack(own, t)) {
+      try {
+        b();
+      } catch (...) {
+        if (!error) error = std::current_exception();
+      }
+    } else {
+      // b refers to the caller's frame, so it must finish before this call returns
+      while (!t->done.load()) {
+        if (this->runOne(own)) continue;
+        std::unique_lock<std::mutex> hold(this->sleepLock_);
+        this->wake_.wait(hold, [this, &t] { return t->done.load() || this->queued_.load() > 0; });
+      }
+      if (!error) error = t->error;
+    }
+    if (error) std::rethrow_exception(error);
+  }
+  
+  // Invoke f(i) for every i in [0, n) by halving the range recursively, so that the
+  //   largest remaining halves are the first to be stolen
+  void task_pool::parallelFor(size_t n, const std::function<void(size_t)>& f) {
+    std::function<void(size_t, size_t)> run = [&](size_t lo, size_t hi) {
+      if (hi - lo == 1) {
+        f(lo);
+        return;
+      }
+      size_t mid = lo + (hi - lo) / 2;
+      this->invoke([&] { run(lo, mid); }, [&] { run(mid, hi); });
+    };
+    if (n > 0) run(0, n);
+  }
+  
+  // Get the index of the calling thread's deque
+  size_t task_pool::ownQueue(void) const {
+    if (currentWorker.pool == this) return currentWorker.queue;
+    return this->queues_.size() - 1;
+  }
+  
+  // Push the given task onto the back of the deque at the given index
+  void task_pool::push(size_t queue, const std::shared_ptr<task>& t) {
+    {
+      std::lock_guard<std::mutex> hold(this->queues_[queue]->lock);
+      this->queues_[queue]->tasks.push_back(t);
+    }
+    {
+      std::lock_guard<std::mutex> hold(this->sleepLock_);
+      this->queued_++;
+    }
+    this->wake_.notify_one();
+  }
+  
+  // Remove the given task from the deque at the given index, returning false if
+  //   another thread has already taken it
+  //
+  // A worker's own tasks are taken back in the reverse of the order in which they
+  //   were pushed, so the task is found at the back unless it was stolen, but the
+  //   deque shared by threads outside the pool may hold other threads' tasks above it.
+  bool task_pool::takeBack(size_t queue, const std::shared_ptr<task>& t) {
+    {
+      std::lock_guard<std::mutex> hold(this->queues_[queue]->lock);
+      std::deque<std::shared_ptr<task>>& tasks = this->queues_[queue]->tasks;
+      auto found = std::find(tasks.rbegin(), tasks.rend(), t);
+      if (found == tasks.rend()) return false;
+      tasks.erase(std::next(found).base());
+    }
+    this->queued_--;
+    return true;
+  }
+  
+  // Run one task, taken from the back of the deque at index (own) or else from the
+  //   front of another deque
+  bool task_pool::runOne(size_t own) {
+    std::shared_ptr<task> t;
+    size_t n = this->queues_.size();
+    for (size_t i = 0; i < n && t == nullptr; i++) {
+      size_t q = (own + i) % n;
+      std::lock_guard<std::mutex> hold(this->queues_[q]->lock);
+      std::deque<std::shared_ptr<task>>& tasks = this->queues_[q]->tasks;
+      if (tasks.empty()) continue;
+      if (i == 0) {
+        t = std::move(tasks.back());
+        tasks.pop_back();
+      } else {
+        t = std::move(tasks.front());
+        tasks.pop_front();
+      }
+    }
+    if (t == nullptr) return false;
+    this->queued_--;
+    
+    try {
+      (*t->fn)();
+    } catch (...) {
+      t->error = std::current_exception();
+    }
+    // the forking thread may be asleep waiting for the task; setting the flag under
+    //   the lock ensures that it either sees the flag or is woken
+    {
+      std::lock_guard<std::mutex> hold(this->sleepLock_);
+      t->done.store(true);
+    }
+    this->wake_.notify_all();
+    return true;
+  }
+  
+  // Run tasks on a worker thread until the pool is destroyed
+  void task_pool::work(size_t index) {
+    currentWorker = worker_identity{ this, index };
+    while (true) {
+      if (this->runOne(index)) continue;
+      std::unique_lock<std::mutex> hold(this->sleepLock_);
+      this->wake_.wait(hold, [this] { return this->stop_ || this->queued_.load() > 0; });
+      if (this->stop_) return;
+    }
+  }
+
+} // namespace proj
@@ -0,0 +1,99 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace proj
+{
+  // The fewest chars worth handing to a thread of their own; smaller ropes are
+  //   processed on the calling thread
+  const size_t MIN_PARALLEL_GRAIN = 1 << 16;
+  // The number of pieces per thread into which parallel operations divide a rope,
+  //   so that threads which finish early can take on more work
+  const size_t PIECES_PER_THREAD = 8;
+  
+  // Get the number of threads used by parallel operations when none is specified
+  size_t defaultThreadCount(void);
+  
+  // A task_pool runs divide-and-conquer work on a fixed set of threads
+  //
+  // Each worker thread owns a deque of tasks. A thread which forks work pushes it
+  //   onto the back of its own deque, and takes it back once its own share of the
+  //   work is done unless another thread has stolen it in the meantime. Idle threads
+  //   steal from the front of the other deques, where the largest pieces of work
+  //   sit. Threads outside the pool share one additional deque. A thread waiting for
+  //   a stolen task runs other tasks meanwhile, and sleeps when there are none.
+  
+  class task_pool {
+  
+  public:
+    
+    // CONSTRUCTORS
+    // Construct a pool in which (threads) threads, counting the calling thread, run
+    //   tasks; a pool of one thread runs every task on the calling thread
+    explicit task_pool(size_t threads = defaultThreadCount());
+    task_pool(const task_pool&) = delete;
+    task_pool& operator=(const task_pool&) = delete;
+    // Stop the worker threads; no thread may be waiting on the pool
+    ~task_pool(void);
+    
+    // ACCESSORS
+    // Get the number of threads which run tasks, counting the calling thread
+    size_t threadCount(void) const;
+    // Get the length of the pieces into which a parallel operation should divide a
+    //   string of (len) chars
+    size_t grainSize(size_t len) const;
+    // Get the pool used by parallel operations when none is specified
+    static task_pool& shared(void);
+    
+    // TASKS
+    // Run both functions, possibly concurrently, returning once both have finished
+    //   and rethrowing the first exception thrown by either
+    void invoke(const std::function<void(void)>& a, const std::function<void(void)>& b);
+    // Invoke f(i) for every i in [0, n), possibly concurrently
+    void parallelFor(size_t n, const std::function<void(size_t)>& f);
+  
+  private:
+    
+    struct task;
+    struct task_queue;
+    
+    // Get the index of the calling thread's deque
+    size_t ownQueue(void) const;
+    // Push the given task onto the back of the deque at the given index
+    void push(size_t queue, const std::shared_ptr<task>& t);
+    // Remove the given task from the deque at the given index, returning false if
+    //   another thread has already taken it
+    bool takeBack(size_t queue, const std::shared_ptr<task>& t);
+    // Run one task, taken from the back of the deque at index (own) or else from the
+    //   front of another deque; return false if every deque was empty
+    bool runOne(size_t own);
+    // Run tasks on a worker thread until the pool is destroyed
+    void work(size_t index);
+    
+    std::vector<std::unique_ptr<task_queue>> queues_;
+    std::vector<std::thread> workers_;
+    // Number of tasks in all deques, guarded by sleepLock_ when incremented so that
+    //   idle workers are not left asleep with tasks waiting; wake_ is also notified
+    //   whenever a task finishes, for the threads waiting on stolen tasks
+    std::atomic<size_t> queued_;
+    std::mutex sleepLock_;
+    std::condition_variable wake_;
+    bool stop_;
+  
+  }; // class task_pool
+
+} // namespace proj
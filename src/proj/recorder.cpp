@@ -0,0 +1,154 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "recorder.hpp"
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+namespace proj
+{
+  // malformed recording error constant
+  std::invalid_argument ERROR_BAD_RECORDING = std::invalid_argument("Error: malformed recording");
+  
+  // Instantiate the recording wrapper of the default rope
+  template class basic_recording_rope<no_summary>;
+  
+  static const char RECORDING_MAGIC[] = "PROJREC";
+  static const unsigned char RECORDING_VERSION = 1;
+  // the char of which redacted text is made
+  static const char FILLER = 'x';
+  
+  // Write the given integer as an unsigned LEB128 varint
+  static void writeVarint(std::ostream& out, uint64_t v) {
+    while (v >= 0x80) {
+      out.put(static_cast<char>((v & 0x7F) | 0x80));
+      v >>= 7;
+    }
+    out.put(static_cast<char>(v));
+  }
+  
+  // Read an unsigned LEB128 varint, returning false at the end of the stream
+  static bool readVarint(std::istream& in, uint64_t& v) {
+    v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+      int c = in.get();
+      if (c == std::char_traits<char>::eof()) return false;
+      v |= static_cast<uint64_t>(c & 0x7F) << shift;
+      if ((c & 0x80) == 0) return true;
+    }
+    throw ERROR_BAD_RECORDING;
+  }
+  
+  // Read a varint which must be present
+  static uint64_t expectVarint(std::istream& in) {
+    uint64_t v;
+    if (!readVarint(in, v)) throw ERROR_BAD_RECORDING;
+    return v;
+  }
+  
+  // Read (len) chars of text which must be present
+  static string expectText(std::istream& in, uint64_t len) {
+    string text;
+    // grow the string as the text arrives, so that a corrupt length cannot force a
+    //   huge allocation up front
+    char buf[4096];
+    while (len > 0) {
+      size_t n = static_cast<size_t>(std::min<uint64_t>(len, sizeof(buf)));
+      if (!in.read(buf, n)) throw ERROR_BAD_RECORDING;
+      text.append(buf, n);
+      len -= n;
+    }
+    return text;
+  }
+  
+  // Begin a recording of operations on the given initial document
+  op_recorder::op_recorder(std::ostream& out, const string& initial, bool redact)
+    : out_(out), redact_(redact), last_(std::chrono::steady_clock::now())
+  {
+    this->out_.write(RECORDING_MAGIC, sizeof(RECORDING_MAGIC) - 1);
+    this->out_.put(static_cast<char>(RECORDING_VERSION));
+    this->out_.put(redact ? 1 : 0);
+    writeVarint(this->out_, initial.length());
+    if (!redact) this->out_.write(initial.data(), initial.length());
+  }
+  
+  // Determine whether text is left out of the recording
+  bool op_recorder::redacted(void) const {
+    return this->redact_;
+  }
+  
+  // Record an operation, timestamping it now
+  void op_recorder::record(recorded_op_kind kind, size_t pos, size_t len, const string& text) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    this->out_.put(static_cast<char>(kind));
+    writeVarint(this->out_, static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->last_).count()));
+    this->last_ = now;
+    if (kind != recorded_op_kind::append) writeVarint(this->out_, pos);
+    if (kind != recorded_op_kind::at) writeVarint(this->out_, len);
+    bool hasText = (kind == recorded_op_kind::insert || kind == recorded_op_kind::append);
+    if (hasText && !this->redact_) this->out_.write(text.data(), len);
+  }
+  
+  // Read the header of the recording in the given stream
+  op_reader::op_reader(std::istream& in, size_t maxLength)
+    : in_(in), redact_(false), timeNs_(0), length_(0), maxLength_(maxLength)
+  {
+    char magic[sizeof(RECORDING_MAGIC) - 1];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, RECORDING_MAGIC, sizeof(magic)) != 0) {
+      throw ERROR_BAD_RECORDING;
+    }
+    int version = in.get();
+    int flags = in.get();
+    if (version != RECORDING_VERSION || flags < 0 || (flags & ~1) != 0) throw ERROR_BAD_RECORDING;
+    this->redact_ = (flags & 1) != 0;
+    uint64_t len = expectVarint(in);
+    if (len > this->maxLength_) throw ERROR_BAD_RECORDING;
+    this->initial_ = this->redact_ ? string(len, FILLER) : expectText(in, len);
+    this->length_ = len;
+  }
+  
+  // Determine whether text was left out of the recording
+  bool op_reader::redacted(void) const {
+    return this->redact_;
+  }
+  
+  // Get the initial document, or filler of its length if the recording is redacted
+  const string& op_reader::initial(void) const {
+    return this->initial_;
+  }
+  
+  // Read the next operation, returning false at the end of the recording
+  bool op_reader::next(recorded_op& op) {
+    int kind = this->in_.get();
+    if (kind == std::char_traits<char>::eof()) return false;
+    if (kind > static_cast<int>(recorded_op_kind::at)) throw ERROR_BAD_RECORDING;
+    op.kind = static_cast<recorded_op_kind>(kind);
+    this->timeNs_ += expectVarint(this->in_);
+    op.timeNs = this->timeNs_;
+    uint64_t pos = (op.kind == recorded_op_kind::append) ? this->length_ : expectVarint(this->in_);
+    uint64_t len = (op.kind == recorded_op_kind::at) ? 0 : expectVarint(this->in_);
+    // the operation must lie within the document, and may not grow it past the limit
+    bool inside = (op.kind == recorded_op_kind::at) ? pos < this->length_ : pos <= this->length_;
+    bool grows = (op.kind == recorded_op_kind::insert || op.kind == recorded_op_kind::append);
+    if (!inside || len > (grows ? this->maxLength_ - this->length_ : this->length_ - pos)) {
+      throw ERROR_BAD_RECORDING;
+    }
+    if (grows) this->length_ += len;
+    else if (op.kind == recorded_op_kind::rdelete) this->length_ -= len;
+    op.pos = (op.kind == recorded_op_kind::append) ? 0 : static_cast<size_t>(pos);
+    op.len = static_cast<size_t>(len);
+    op.text.clear();
+    if (op.kind == recorded_op_kind::insert || op.kind == recorded_op_kind::append) {
+      op.text = this->redact_ ? string(op.len, FILLER) : expectText(this->in_, op.len);
+    }
+    return true;
+  }
+
+} // namespace proj
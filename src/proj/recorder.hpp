@@ -0,0 +1,219 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include "rope.hpp"
+
+namespace proj
+{
+  // malformed recording error constant
+  extern std::invalid_argument ERROR_BAD_RECORDING;
+  
+  // Operation recordings
+  //
+  // A recording_rope wraps a rope and logs every call made through it to an
+  //   op_recorder, so that a real workload can be captured and later replayed by an
+  //   op_reader against any build of the rope. A redacted recording keeps the
+  //   positions and lengths of the operations but none of the text, so it may be
+  //   taken from documents which must not leave the machine; inserted text and the
+  //   initial document are replayed as filler of the same length.
+  //
+  // The format is a header followed by one record per operation, where every integer
+  //   is an unsigned LEB128 varint:
+  //     header:  "PROJREC" version(1 byte) flags(1 byte, bit 0 = redacted)
+  //              initial length [initial text, unless redacted]
+  //     record:  kind(1 byte) nanoseconds since the previous record, then
+  //                insert:    pos len [text, unless redacted]
+  //                append:    len [text, unless redacted]
+  //                rdelete:   pos len
+  //                substring: pos len
+  //                at:        pos
+  
+  // The operations which are recorded
+  enum class recorded_op_kind : unsigned char { insert, append, rdelete, substring, at };
+  
+  // A recorded operation; fields not used by its kind are 0 or empty
+  struct recorded_op {
+    recorded_op_kind kind;
+    // nanoseconds between the start of the recording and the operation
+    uint64_t timeNs;
+    size_t pos;
+    size_t len;
+    string text;
+  };
+  
+  // An op_recorder writes operations to a stream in the recording format
+  class op_recorder {
+  
+  public:
+    
+    // Begin a recording of operations on the given initial document
+    op_recorder(std::ostream& out, const string& initial, bool redact = false);
+    
+    // Determine whether text is left out of the recording
+    bool redacted(void) const;
+    // Record an operation, timestamping it now; the text of inserts and appends is
+    //   taken from (text), and for other kinds it is ignored
+    void record(recorded_op_kind kind, size_t pos, size_t len, const string& text = string());
+  
+  private:
+    
+    std::ostream& out_;
+    bool redact_;
+    std::chrono::steady_clock::time_point last_;
+  
+  }; // class op_recorder
+  
+  // The default limit on the length of the document replayed from a recording
+  const size_t MAX_REPLAY_LENGTH = size_t(1) << 30;
+  
+  // An op_reader reads operations back from a recording
+  //
+  // The reader follows the length of the replayed document, rejecting any operation
+  //   outside it, and any which would make it longer than the given limit. A redacted
+  //   recording holds no text to bound the filler it asks for, so the limit keeps a
+  //   corrupt length from forcing an allocation of any size.
+  class op_reader {
+  
+  public:
+    
+    // Read the header of the recording in the given stream, throwing
+    //   ERROR_BAD_RECORDING if it is not a recording or its initial document is
+    //   longer than (maxLength)
+    explicit op_reader(std::istream& in, size_t maxLength = MAX_REPLAY_LENGTH);
+    
+    // Determine whether text was left out of the recording
+    bool redacted(void) const;
+    // Get the initial document, or filler of its length if the recording is redacted
+    const string& initial(void) const;
+    // Read the next operation, returning false at the end of the recording; the text
+    //   of a redacted insert or append is filler. Throws ERROR_BAD_RECORDING if the
+    //   record is malformed or truncated, lies outside the replayed document, or
+    //   would make it longer than the limit.
+    bool next(recorded_op& op);
+  
+  private:
+    
+    std::istream& in_;
+    bool redact_;
+    string initial_;
+    uint64_t timeNs_;
+    // the length of the document after the operations read so far, and its limit
+    uint64_t length_;
+    uint64_t maxLength_;
+  
+  }; // class op_reader
+  
+  // A recording_rope forwards each operation to the rope it holds and records it
+  //
+  // Operations which throw are not recorded, so every recorded operation is valid
+  //   against the document as replayed.
+  template <typename Summary>
+  class basic_recording_rope {
+  
+  public:
+    
+    using rope_type = basic_rope<Summary>;
+    
+    // Record the operations on a copy of the given rope to the given recorder, which
+    //   must have been begun with the string of that rope
+    basic_recording_rope(const rope_type& r, op_recorder& recorder);
+    
+    // Get the wrapped rope
+    const rope_type& current(void) const;
+    size_t length(void) const;
+    char at(size_t index);
+    string substring(size_t start, size_t len);
+    void insert(size_t i, const string& str);
+    void append(const string& str);
+    void rdelete(size_t start, size_t len);
+  
+  private:
+    
+    rope_type rope_;
+    op_recorder& recorder_;
+  
+  }; // class basic_recording_rope
+  
+  using recording_rope = basic_recording_rope<no_summary>;
+  
+  // Apply the given recorded operation to the given rope, returning the result of a
+  //   read (the char read, or the length of the substring) or else the new length
+  template <typename Summary>
+  size_t playOp(basic_rope<Summary>& r, const recorded_op& op) {
+    switch (op.kind) {
+      case recorded_op_kind::insert: r.insert(op.pos, op.text); break;
+      case recorded_op_kind::append: r.append(op.text); break;
+      case recorded_op_kind::rdelete: r.rdelete(op.pos, op.len); break;
+      case recorded_op_kind::substring: return r.substring(op.pos, op.len).length();
+      case recorded_op_kind::at: return static_cast<unsigned char>(r.at(op.pos));
+    }
+    return r.length();
+  }
+  
+  // Record the operations on a copy of the given rope
+  template <typename Summary>
+  basic_recording_rope<Summary>::basic_recording_rope(const rope_type& r, op_recorder& recorder)
+    : rope_(r), recorder_(recorder)
+  {}
+  
+  // Get the wrapped rope
+  template <typename Summary>
+  const basic_rope<Summary>& basic_recording_rope<Summary>::current(void) const {
+    return this->rope_;
+  }
+  
+  // Get the length of the wrapped rope, which is not recorded
+  template <typename Summary>
+  size_t basic_recording_rope<Summary>::length(void) const {
+    return this->rope_.length();
+  }
+  
+  // Get the character at the given position, recording the read
+  template <typename Summary>
+  char basic_recording_rope<Summary>::at(size_t index) {
+    char c = this->rope_.at(index);
+    this->recorder_.record(recorded_op_kind::at, index, 0);
+    return c;
+  }
+  
+  // Get the substring of (len) chars beginning at index (start), recording the read
+  template <typename Summary>
+  string basic_recording_rope<Summary>::substring(size_t start, size_t len) {
+    string result = this->rope_.substring(start, len);
+    this->recorder_.record(recorded_op_kind::substring, start, len);
+    return result;
+  }
+  
+  // Insert the given string at the specified index, recording the insertion
+  template <typename Summary>
+  void basic_recording_rope<Summary>::insert(size_t i, const string& str) {
+    this->rope_.insert(i, str);
+    this->recorder_.record(recorded_op_kind::insert, i, str.length(), str);
+  }
+  
+  // Append the given string, recording the append
+  template <typename Summary>
+  void basic_recording_rope<Summary>::append(const string& str) {
+    this->rope_.append(str);
+    this->recorder_.record(recorded_op_kind::append, 0, str.length(), str);
+  }
+  
+  // Delete the (len) chars beginning at index (start), recording the deletion
+  template <typename Summary>
+  void basic_recording_rope<Summary>::rdelete(size_t start, size_t len) {
+    this->rope_.rdelete(start, len);
+    this->recorder_.record(recorded_op_kind::rdelete, start, len);
+  }
+  
+  extern template class basic_recording_rope<no_summary>;
+
+} // namespace proj
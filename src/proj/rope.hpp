@@ -8,12 +8,62 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <ostream>
+#include "latency.hpp"
 #include "node.hpp"
 
 namespace proj
 {
   using std::string;
   
+  // out-of-bounds error constant
+  extern std::invalid_argument ERROR_OOB_ROPE;
+  // unordered edits error constant
+  extern std::invalid_argument ERROR_EDIT_ORDER;
+  // unordered positions error constant
+  extern std::invalid_argument ERROR_POSITION_ORDER;
+  
+  size_t fib(size_t n);
+  // Get the greatest depth d for which fib(d+2) <= len, i.e. the greatest depth at
+  //   which a tree holding (len) chars can satisfy the balance condition
+  size_t maxBalancedDepth(size_t len);
+  
+  // How a rope keeps its tree balanced
+  //   rebuild: each edit rebuilds only the nodes on its path, leaving the tree
+  //            unbalanced until balance() rebuilds it from its leaves
+  //   join:    each edit rejoins the pieces it splits with concatBalanced, so the
+  //            tree remains of O(log n) depth after every edit; an inserted or
+  //            appended rope which is not balanced is rebuilt before it is joined
+  enum class balancing { rebuild, join };
+  
+  // When a rope calls balance() of its own accord, after each edit
+  //   never:     only when balance() is called explicitly
+  //   depth:     once the depth of the tree exceeds (limit), as with the maximum
+  //              depth of the SGI rope
+  //   edits:     once (limit) edits have been made since the last balance()
+  //   fibonacci: once the tree no longer satisfies isBalanced, which is an O(1)
+  //              check of the cached depth
+  enum class rebalance_trigger { never, depth, edits, fibonacci };
+  
+  struct rebalance_policy {
+    rebalance_trigger trigger;
+    size_t limit;
+  };
+  
+  // The number of rebalances a rope's policy has fired and the time spent in them
+  struct rebalance_stats {
+    size_t count;
+    std::chrono::nanoseconds time;
+  };
+  
+  template <typename Summary>
+  class basic_rope_history;
+  template <typename Summary>
+  class basic_rope_builder;
+  
   // A rope represents a string as a binary tree wherein the leaves contain fragments of the
   //   string. More accurately, a rope consists of a pointer to a root rope_node, which
   //   describes a binary tree of string fragments.
@@ -31,58 +81,876 @@ namespace proj
   //  "some" "text"  |  root is an internal node formed by the concatenation of two distinct
   //    /\     /\    |  ropes containing the strings "some" and "text"
   //   X  X   X  X   |
+  //
+  // Every node of a rope caches a summary (see node.hpp) of the string held in its
+  //   subtree. Ropes instantiated with a custom Summary type support O(log n) queries
+  //   over those summaries by way of prefixSummary and seek.
+  //
+  // Since nodes are immutable, copying a rope shares its tree in O(1) time, and each
+  //   subsequent edit to either copy rebuilds only the nodes on the edited paths.
+  
+  template <typename Summary>
+  class basic_rope {
   
-  class rope {
-    
   public:
     
-    using handle = std::unique_ptr<rope_node>;
+    using node = basic_rope_node<Summary>;
+    using handle = node_handle<Summary>;
+    using edit = rope_edit;
     
     // CONSTRUCTORS
     // Default constructor - produces a rope representing the empty string
-    rope(void);
+    basic_rope(void);
     // Construct a rope from the given string
-    rope(const string&);
+    basic_rope(const string&);
     // Copy constructor
-    rope(const rope&);
+    basic_rope(const basic_rope&);
     
     // Get the string stored in the rope
     string toString(void) const;
+    // Copy the stored string to the given buffer, which must hold length() chars
+    void copyTo(char * dst) const;
+    // Copy the stored string to the given buffer, dividing the work between the
+    //   threads of the given pool
+    void copyToParallel(char * dst, task_pool& pool = task_pool::shared()) const;
+    // Get the string stored in the rope, flattened on the given pool
+    string toStringParallel(task_pool& pool = task_pool::shared()) const;
     // Get the length of the stored string
     size_t length(void) const;
     // Get the character at the given position in the represented string
     char at(size_t index) const;
     // Return the substring of length (len) beginning at the specified index
     string substring(size_t start, size_t len) const;
+    
+    // SERIALIZATION
+    // Write the tree of the rope to the stream in a compact, versioned binary format
+    //   (see writeTree in node.hpp) which keeps its shape
+    void serialize(std::ostream& out) const;
+    // Read a rope written by serialize, throwing ERROR_BAD_SERIALIZATION if the
+    //   stream does not hold one; the rope has the default balancing mode and policy
+    static basic_rope deserialize(std::istream& in);
+    
+    // SEARCH
+    // Every index at which the needle occurs is a match, including matches which
+    //   overlap one another. An empty needle matches at every index.
+    // Get the first index at or after (pos) at which the needle occurs, or
+    //   string::npos if there is none
+    size_t find(const string& needle, size_t pos = 0) const;
+    // Get the first index at which the needle occurs, searching on the given pool
+    size_t findParallel(const string& needle, task_pool& pool = task_pool::shared()) const;
+    // Get every index at which the needle occurs, in increasing order
+    std::vector<size_t> findAllParallel(const string& needle, task_pool& pool = task_pool::shared()) const;
+    // Get the number of indices at which the needle occurs
+    size_t countParallel(const string& needle, task_pool& pool = task_pool::shared()) const;
+    
+    // POSITION CONVERSION
+    // Byte indices address the UTF-8 encoded string; UTF-16 offsets count the code
+    //   units of the same string re-encoded as UTF-16 (as used by e.g. the Language
+    //   Server Protocol). Lines are delimited by '\n' and numbered from 0.
+    // Get the number of UTF-16 code units encoding the stored string
+    size_t utf16Length(void) const;
+    // Get the number of lines in the stored string
+    size_t lineCount(void) const;
+    // Get the byte index of the code point containing the given UTF-16 offset
+    size_t utf16ToByte(size_t units) const;
+    // Get the UTF-16 offset of the given byte index
+    size_t byteToUtf16(size_t index) const;
+    // Get the byte index at which the given line begins
+    size_t lineToByte(size_t line) const;
+    // Get the line containing the given byte index
+    size_t byteToLine(size_t index) const;
+    // Get the (line, UTF-16 column) position of the given byte index
+    std::pair<size_t, size_t> byteToLineUtf16(size_t index) const;
+    // Get the byte index of the given (line, UTF-16 column) position, where columns
+    //   past the end of the line are clamped to the end of the line
+    size_t lineUtf16ToByte(size_t line, size_t column) const;
+    
+    // SUMMARIES
+    // Get the summary of the stored string
+    Summary summary(void) const;
+    // Get the summary of the first (index) characters of the stored string
+    Summary prefixSummary(size_t index) const;
+    // Get the length of the shortest prefix of the stored string whose summary
+    //   satisfies the given monotone predicate, or string::npos if there is none
+    template <typename Pred>
+    size_t seek(Pred pred) const;
+    
     // Determine if rope is balanced
     bool isBalanced(void) const;
+    // Get the depth of the tree, which is 0 for a single leaf
+    size_t depth(void) const;
+    // Get the structural statistics of the tree, in a single pass over its nodes
+    rope_stats stats(void) const;
+    // Get the way in which the rope keeps its tree balanced
+    balancing balancingMode(void) const;
+    // Set the way in which the rope keeps its tree balanced, rebuilding the tree if
+    //   join balancing is chosen for an unbalanced rope
+    void setBalancingMode(balancing mode);
     // Balance the rope
     void balance(void);
+    // Get the policy under which the rope balances itself after edits
+    rebalance_policy rebalancePolicy(void) const;
+    // Set the policy under which the rope balances itself after edits
+    void setRebalancePolicy(rebalance_policy policy);
+    // Get the number of rebalances fired by the policy, and the time they took
+    rebalance_stats rebalanceStats(void) const;
+    // Balance the rope by rebuilding it as a tree of minimal depth over its leaves,
+    //   dividing the work between the threads of the given pool
+    void balanceParallel(task_pool& pool = task_pool::shared());
     
     // MUTATORS
     // Insert the given string/rope into the rope, beginning at the specified index (i)
     void insert(size_t i, const string& str);
-    void insert(size_t i, const rope& r);
+    void insert(size_t i, const basic_rope& r);
     // Concatenate the existing string/rope with the argument
     void append(const string&);
-    void append(const rope&);
+    void append(const basic_rope&);
     // Delete the substring of (len) characters beginning at index (start)
     void rdelete(size_t start, size_t len);
+    // Apply a batch of edits, sorted by offset and non-overlapping, whose offsets all
+    //   refer to the string as it was before any of the edits were applied
+    void applyEdits(const std::vector<edit>& edits);
+    // Insert the given string/rope at each of the given sorted indices, where every
+    //   index refers to the string as it was before any of the insertions
+    void insertAtAll(const std::vector<size_t>& positions, const string& str);
+    void insertAtAll(const std::vector<size_t>& positions, const basic_rope& r);
     
-    // OPERATORS
-    rope& operator=(const rope& rhs);
-    bool operator==(const rope& rhs) const;
-    bool operator!=(const rope& rhs) const;
-    friend std::ostream& operator<<(std::ostream& out, const rope& r);
+    // SPLIT AND CONCATENATE
+    // The following rebalance the nodes they rebuild, so that ropes which satisfy the
+    //   AVL condition (see concatBalanced in node.hpp) continue to satisfy it
+    // Split the rope at the given index into the ropes holding the chars before and
+    //   from the index, in O(log n) time
+    std::pair<basic_rope, basic_rope> split(size_t index) const;
+    // Concatenate the given ropes in O(log n) time
+    static basic_rope concat(basic_rope&& l, basic_rope&& r);
     
+    // OPERATORS
+    basic_rope& operator=(const basic_rope& rhs);
+    bool operator==(const basic_rope& rhs) const;
+    bool operator!=(const basic_rope& rhs) const;
+  
   private:
     
+    template <typename S>
+    friend class basic_rope_history;
+    template <typename S>
+    friend class basic_rope_builder;
+    
+    // Invoke f(i) for each match at an index i in [lo, hi), in increasing order,
+    //   until f returns false; the needle must not be empty
+    template <typename F>
+    void scanRange(const string& needle, size_t lo, size_t hi, F f) const;
+    
+    // Construct a rope with the given root, or the empty string if it is null
+    explicit basic_rope(handle root, balancing mode = balancing::rebuild);
+    
+    // Get the given root, or a leaf holding the empty string if it is null
+    static handle orEmpty(handle root);
+    // Rebuild the tree as a tree of minimal depth over its non-empty leaves
+    void rebuild(void);
+    // Build a tree of minimal depth over the non-empty leaves of the given subtree
+    static handle minimalTree(const handle& root);
+    // Determine if the given subtree satisfies the balance condition of isBalanced
+    static bool fibBalanced(const handle& n);
+    // Determine if the given subtree is near enough to the balance condition for
+    //   rebalanceLocal to mend it by rejoining its children
+    static bool nearlyBalanced(const handle& n);
+    // Get the given subtree for joining with concatBalanced, rebuilt as a tree of
+    //   minimal depth if it is not balanced
+    static handle joinable(const handle& n);
+    // Replace the (len) chars beginning at index (start) with the given subtree by
+    //   splitting and rejoining the tree with splitBalanced and concatBalanced
+    void spliceBalanced(size_t start, size_t len, const handle& text);
+    // Count an edit, balancing the rope if the rebalance policy calls for it
+    void edited(void);
+    
     // Pointer to the root of the rope tree
     handle root_;
+    balancing balancing_;
+    rebalance_policy policy_;
+    size_t editsSinceBalance_;
+    rebalance_stats stats_;
+  
+  }; // class basic_rope
+  
+  using rope = basic_rope<no_summary>;
+  
+  // Print the rope
+  template <typename Summary>
+  std::ostream& operator<<(std::ostream& out, const basic_rope<Summary>& r);
+  
+  // Default constructor - produces a rope representing the empty string
+  template <typename Summary>
+  basic_rope<Summary>::basic_rope(void) : basic_rope("")
+  {}
+  
+  // Construct a rope from the given string
+  template <typename Summary>
+  basic_rope<Summary>::basic_rope(const string& str)
+    : balancing_(balancing::rebuild), policy_{ rebalance_trigger::never, 0 },
+      editsSinceBalance_(0), stats_{ 0, std::chrono::nanoseconds(0) }
+  {
+    this->root_ = std::make_shared<const node>(str);
+  }
+  
+  // Construct a rope with the given root, or the empty string if it is null
+  template <typename Summary>
+  basic_rope<Summary>::basic_rope(handle root, balancing mode)
+    : root_(orEmpty(std::move(root))), balancing_(mode), policy_{ rebalance_trigger::never, 0 },
+      editsSinceBalance_(0), stats_{ 0, std::chrono::nanoseconds(0) }
+  {}
+  
+  // Copy constructor - the copy shares the tree of the original, and takes on its
+  //   balancing mode, rebalance policy and rebalance counters
+  template <typename Summary>
+  basic_rope<Summary>::basic_rope(const basic_rope& r)
+    : root_(r.root_), balancing_(r.balancing_), policy_(r.policy_),
+      editsSinceBalance_(r.editsSinceBalance_), stats_(r.stats_)
+  {}
+  
+  // Get the string stored in the rope
+  template <typename Summary>
+  string basic_rope<Summary>::toString(void) const {
+    if(this->root_ == nullptr)
+      return "";
+    return this->root_->treeToString();
+  }
+  
+  // Copy the stored string to the given buffer
+  template <typename Summary>
+  void basic_rope<Summary>::copyTo(char * dst) const {
+    if(this->root_ != nullptr)
+      this->root_->copyTo(dst);
+  }
+  
+  // Copy the stored string to the given buffer on the given pool
+  //
+  // The tree is divided, using the lengths cached in its nodes, into subtrees whose
+  //   strings occupy disjoint ranges of the buffer, and the subtrees are then copied
+  //   concurrently.
+  template <typename Summary>
+  void basic_rope<Summary>::copyToParallel(char * dst, task_pool& pool) const {
+    if(this->root_ == nullptr) return;
+    parallelReduce<size_t>(this->root_, 0, pool.grainSize(this->length()), pool,
+      [dst](const handle& n, size_t offset) {
+        n->copyTo(dst + offset);
+        return n->getLength();
+      },
+      [](size_t l, size_t r) { return l + r; });
+  }
+  
+  // Get the string stored in the rope, flattened on the given pool
+  template <typename Summary>
+  string basic_rope<Summary>::toStringParallel(task_pool& pool) const {
+    string result(this->length(), '\0');
+    this->copyToParallel(&result[0], pool);
+    return result;
+  }
+  
+  // Get the length of the stored string
+  template <typename Summary>
+  size_t basic_rope<Summary>::length(void) const {
+    if(this->root_ == nullptr)
+      return 0;
+    return this->root_->getLength();
+  }
+  
+  // Get the character at the given position in the represented string
+  template <typename Summary>
+  char basic_rope<Summary>::at(size_t index) const {
+    if(this->root_ == nullptr)
+      throw ERROR_OOB_ROPE;
+    return this->root_->getCharByIndex(index);
+  }
+  
+  // Return the substring of length (len) beginning at the specified index
+  template <typename Summary>
+  string basic_rope<Summary>::substring(size_t start, size_t len) const {
+    PROJ_TIME_OP(substring);
+    size_t actualLength = this->length();
+    if (start > actualLength || (start+len) > actualLength) throw ERROR_OOB_ROPE;
+    return this->root_->getSubstring(start, len);
+  }
+  
+  // Write the tree of the rope to the stream in a compact binary format
+  template <typename Summary>
+  void basic_rope<Summary>::serialize(std::ostream& out) const {
+    writeTree(this->root_, out);
+  }
+  
+  // Read a rope written by serialize
+  template <typename Summary>
+  basic_rope<Summary> basic_rope<Summary>::deserialize(std::istream& in) {
+    return basic_rope(readTree<Summary>(in));
+  }
+  
+  // Get the first index at or after (pos) at which the needle occurs
+  template <typename Summary>
+  size_t basic_rope<Summary>::find(const string& needle, size_t pos) const {
+    size_t len = this->length();
+    if (pos > len) return string::npos;
+    if (needle.empty()) return pos;
+    size_t result = string::npos;
+    this->scanRange(needle, pos, len, [&](size_t i) {
+      result = i;
+      return false;
+    });
+    return result;
+  }
+  
+  // Get the first index at which the needle occurs, searching on the given pool
+  //
+  // Subtrees beginning after a match already found are skipped.
+  template <typename Summary>
+  size_t basic_rope<Summary>::findParallel(const string& needle, task_pool& pool) const {
+    if (needle.empty()) return 0;
+    std::atomic<size_t> best(string::npos);
+    return parallelReduce<size_t>(this->root_, 0, pool.grainSize(this->length()), pool,
+      [&](const handle& n, size_t offset) {
+        size_t result = string::npos;
+        if (offset > best.load()) return result;
+        this->scanRange(needle, offset, offset + n->getLength(), [&](size_t i) {
+          result = i;
+          return false;
+        });
+        size_t seen = best.load();
+        while (result < seen && !best.compare_exchange_weak(seen, result)) {}
+        return result;
+      },
+      [](size_t l, size_t r) { return (l != string::npos) ? l : r; });
+  }
+  
+  // Get every index at which the needle occurs, in increasing order
+  template <typename Summary>
+  std::vector<size_t> basic_rope<Summary>::findAllParallel(const string& needle, task_pool& pool) const {
+    using matches = std::vector<size_t>;
+    if (needle.empty()) {
+      matches result;
+      for (size_t i = 0; i <= this->length(); i++) result.push_back(i);
+      return result;
+    }
+    return parallelReduce<matches>(this->root_, 0, pool.grainSize(this->length()), pool,
+      [&](const handle& n, size_t offset) {
+        matches result;
+        this->scanRange(needle, offset, offset + n->getLength(), [&](size_t i) {
+          result.push_back(i);
+          return true;
+        });
+        return result;
+      },
+      [](matches l, matches r) {
+        l.insert(l.end(), r.begin(), r.end());
+        return l;
+      });
+  }
+  
+  // Get the number of indices at which the needle occurs
+  template <typename Summary>
+  size_t basic_rope<Summary>::countParallel(const string& needle, task_pool& pool) const {
+    if (needle.empty()) return this->length() + 1;
+    return parallelReduce<size_t>(this->root_, 0, pool.grainSize(this->length()), pool,
+      [&](const handle& n, size_t offset) {
+        size_t count = 0;
+        this->scanRange(needle, offset, offset + n->getLength(), [&](size_t) {
+          count++;
+          return true;
+        });
+        return count;
+      },
+      [](size_t l, size_t r) { return l + r; });
+  }
+  
+  // Invoke f(i) for each match at an index i in [lo, hi)
+  //
+  // The range is flattened one window of MIN_PARALLEL_GRAIN chars at a time into a
+  //   reused buffer. A match beginning in a window may end beyond it, so each window
+  //   extends (needle.length() - 1) chars past its end; each match is therefore
+  //   found by exactly the one window in which it begins.
+  template <typename Summary>
+  template <typename F>
+  void basic_rope<Summary>::scanRange(const string& needle, size_t lo, size_t hi, F f) const {
+    size_t len = this->length();
+    string window;
+    for (size_t start = lo; start < hi; start += MIN_PARALLEL_GRAIN) {
+      size_t stop = std::min(hi, start + MIN_PARALLEL_GRAIN);
+      size_t end = std::min(len, stop + needle.length() - 1);
+      if (end < start + needle.length()) return;
+      window.resize(end - start);
+      this->root_->copyRangeTo(start, end - start, &window[0]);
+      for (size_t i = window.find(needle); i != string::npos && start + i < stop; i = window.find(needle, i + 1)) {
+        if (!f(start + i)) return;
+      }
+    }
+  }
+  
+  // Get the number of UTF-16 code units encoding the stored string
+  template <typename Summary>
+  size_t basic_rope<Summary>::utf16Length(void) const {
+    if(this->root_ == nullptr)
+      return 0;
+    return this->root_->getUtf16Length();
+  }
+  
+  // Get the number of lines in the stored string
+  template <typename Summary>
+  size_t basic_rope<Summary>::lineCount(void) const {
+    if(this->root_ == nullptr)
+      return 1;
+    return this->root_->getNewlineCount() + 1;
+  }
+  
+  // Get the byte index of the code point containing the given UTF-16 offset
+  template <typename Summary>
+  size_t basic_rope<Summary>::utf16ToByte(size_t units) const {
+    if (units > this->utf16Length()) throw ERROR_OOB_ROPE;
+    return this->root_->getByteByUtf16(units);
+  }
+  
+  // Get the UTF-16 offset of the given byte index
+  template <typename Summary>
+  size_t basic_rope<Summary>::byteToUtf16(size_t index) const {
+    if (index > this->length()) throw ERROR_OOB_ROPE;
+    return this->root_->getUtf16ByByte(index);
+  }
+  
+  // Get the byte index at which the given line begins
+  template <typename Summary>
+  size_t basic_rope<Summary>::lineToByte(size_t line) const {
+    if (line >= this->lineCount()) throw ERROR_OOB_ROPE;
+    if (line == 0) return 0;
+    return this->root_->getByteByNewline(line);
+  }
+  
+  // Get the line containing the given byte index
+  template <typename Summary>
+  size_t basic_rope<Summary>::byteToLine(size_t index) const {
+    if (index > this->length()) throw ERROR_OOB_ROPE;
+    return this->root_->getNewlinesByByte(index);
+  }
+  
+  // Get the (line, UTF-16 column) position of the given byte index
+  template <typename Summary>
+  std::pair<size_t, size_t> basic_rope<Summary>::byteToLineUtf16(size_t index) const {
+    size_t line = this->byteToLine(index);
+    size_t lineStart = this->lineToByte(line);
+    return std::pair<size_t, size_t>{
+      line, this->byteToUtf16(index) - this->byteToUtf16(lineStart)
+    };
+  }
+  
+  // Get the byte index of the given (line, UTF-16 column) position
+  template <typename Summary>
+  size_t basic_rope<Summary>::lineUtf16ToByte(size_t line, size_t column) const {
+    size_t lineStart = this->lineToByte(line);
+    // the end of a line excludes its terminating newline
+    size_t lineEnd = (line + 1 < this->lineCount()) ?
+      this->lineToByte(line + 1) - 1 : this->length();
+    size_t startUnits = this->byteToUtf16(lineStart);
+    size_t endUnits = this->byteToUtf16(lineEnd);
+    return this->utf16ToByte(std::min(startUnits + column, endUnits));
+  }
+  
+  // Get the summary of the stored string
+  template <typename Summary>
+  Summary basic_rope<Summary>::summary(void) const {
+    if(this->root_ == nullptr)
+      return Summary();
+    return this->root_->getSummary();
+  }
+  
+  // Get the summary of the first (index) characters of the stored string
+  template <typename Summary>
+  Summary basic_rope<Summary>::prefixSummary(size_t index) const {
+    if (index > this->length()) throw ERROR_OOB_ROPE;
+    return this->root_->getPrefixSummary(index);
+  }
+  
+  // Get the length of the shortest prefix of the stored string whose summary
+  //   satisfies the given monotone predicate, or string::npos if there is none
+  template <typename Summary>
+  template <typename Pred>
+  size_t basic_rope<Summary>::seek(Pred pred) const {
+    Summary acc = Summary();
+    if (pred(acc)) return 0;
+    if (this->root_ == nullptr) return string::npos;
+    return this->root_->seek(pred, acc);
+  }
+  
+  // Insert the given string into the rope, beginning at the specified index (i)
+  template <typename Summary>
+  void basic_rope<Summary>::insert(size_t i, const string& str) {
+    this->insert(i,basic_rope(str));
+  }
+  
+  // Insert the given rope into the rope, beginning at the specified index (i)
+  template <typename Summary>
+  void basic_rope<Summary>::insert(size_t i, const basic_rope& r) {
+    PROJ_TIME_OP(insert);
+    if (this->length() < i) {
+      throw ERROR_OOB_ROPE;
+    } else {
+      if (this->balancing_ == balancing::join) {
+        this->spliceBalanced(i, 0, joinable(r.root_));
+      } else {
+        PROJ_TRACE_SPAN("splitAt", this->length());
+        std::pair<handle, handle> origRopeSplit = splitAt(this->root_,i);
+        handle tmpConcat = std::make_shared<const node>(origRopeSplit.first, r.root_);
+        this->root_ = std::make_shared<const node>(tmpConcat, origRopeSplit.second);
+      }
+      this->edited();
+    }
+  }
+  
+  // Append the argument to the existing rope
+  template <typename Summary>
+  void basic_rope<Summary>::append(const string& str) {
+    this->append(basic_rope(str));
+  }
+  
+  // Append the argument to the existing rope
+  template <typename Summary>
+  void basic_rope<Summary>::append(const basic_rope& r) {
+    if (this->balancing_ == balancing::join) {
+      this->root_ = orEmpty(concatBalanced(this->root_, joinable(r.root_)));
+    } else {
+      this->root_ = std::make_shared<const node>(this->root_, r.root_);
+    }
+    this->edited();
+  }
+  
+  // Delete the substring of (len) characters beginning at index (start)
+  template <typename Summary>
+  void basic_rope<Summary>::rdelete(size_t start, size_t len) {
+    PROJ_TIME_OP(rdelete);
+    size_t actualLength = this->length();
+    if (start > actualLength || start+len > actualLength) {
+      throw ERROR_OOB_ROPE;
+    } else {
+      if (this->balancing_ == balancing::join) {
+        this->spliceBalanced(start, len, nullptr);
+      } else {
+        PROJ_TRACE_SPAN("splitAt", actualLength);
+        std::pair<handle, handle> firstSplit = splitAt(this->root_,start);
+        std::pair<handle, handle> secondSplit = splitAt(firstSplit.second,len);
+        this->root_ = std::make_shared<const node>(firstSplit.first, secondSplit.second);
+      }
+      this->edited();
+    }
+  }
+  
+  // Apply a batch of sorted, non-overlapping edits in a single pass over the tree
+  //
+  // Each edit's offset refers to the string as it was before the batch, so callers
+  //   need not adjust the offsets of later edits for the lengths of earlier ones.
+  template <typename Summary>
+  void basic_rope<Summary>::applyEdits(const std::vector<edit>& edits) {
+    if (edits.empty()) return;
+    size_t actualLength = this->length();
+    for (size_t i = 0; i < edits.size(); i++) {
+      const edit& e = edits[i];
+      if (e.offset > actualLength || e.offset + e.deleteLen > actualLength) throw ERROR_OOB_ROPE;
+      if (i > 0 && edits[i-1].offset + edits[i-1].deleteLen > e.offset) throw ERROR_EDIT_ORDER;
+    }
+    if (this->balancing_ == balancing::join) {
+      // apply the edits from last to first, so that earlier offsets remain valid
+      for (auto e = edits.rbegin(); e != edits.rend(); e++) {
+        this->spliceBalanced(e->offset, e->deleteLen, std::make_shared<const node>(e->insertText));
+      }
+    } else {
+      this->root_ = applyEditsAt(this->root_, 0, true, edits.data(), edits.data() + edits.size());
+    }
+    this->edited();
+  }
+  
+  // Insert the given string at each of the given sorted indices
+  template <typename Summary>
+  void basic_rope<Summary>::insertAtAll(const std::vector<size_t>& positions, const string& str) {
+    this->insertAtAll(positions, basic_rope(str));
+  }
+  
+  // Insert the given rope at each of the given sorted indices in a single pass over
+  //   the tree, splitting each affected leaf once
+  template <typename Summary>
+  void basic_rope<Summary>::insertAtAll(const std::vector<size_t>& positions, const basic_rope& r) {
+    if (positions.empty()) return;
+    if (!std::is_sorted(positions.begin(), positions.end())) throw ERROR_POSITION_ORDER;
+    if (positions.back() > this->length()) throw ERROR_OOB_ROPE;
+    if (this->balancing_ == balancing::join) {
+      handle text = joinable(r.root_);
+      for (auto i = positions.rbegin(); i != positions.rend(); i++) this->spliceBalanced(*i, 0, text);
+    } else {
+      this->root_ = insertAllAt(this->root_, 0, true,
+        positions.data(), positions.data() + positions.size(), r.root_);
+    }
+    this->edited();
+  }
+  
+  // Split the rope at the given index
+  template <typename Summary>
+  std::pair<basic_rope<Summary>, basic_rope<Summary>> basic_rope<Summary>::split(size_t index) const {
+    if (index > this->length()) throw ERROR_OOB_ROPE;
+    std::pair<handle, handle> pieces = splitBalanced(this->root_, index);
+    return std::make_pair(basic_rope(pieces.first, this->balancing_),
+                          basic_rope(pieces.second, this->balancing_));
+  }
+  
+  // Concatenate the given ropes, producing a rope with the balancing mode of the first
+  //
+  // Either rope is rebuilt first if it is not balanced, so that the result is.
+  template <typename Summary>
+  basic_rope<Summary> basic_rope<Summary>::concat(basic_rope&& l, basic_rope&& r) {
+    return basic_rope(concatBalanced(joinable(l.root_), joinable(r.root_)), l.balancing_);
+  }
+  
+  // Determine if rope is balanced
+  //
+  // A rope is balanced if and only if its length is greater than or equal to
+  //   fib(d+2) where d refers to the depth of the rope and fib(n) represents
+  //   the nth fibonacci number i.e. in the set {1,1,2,3,5,8,etc...}
+  template <typename Summary>
+  bool basic_rope<Summary>::isBalanced(void) const{
+    if(this->root_ == nullptr)
+      return true;
+    return fibBalanced(this->root_);
+  }
+  
+  // Get the depth of the tree
+  template <typename Summary>
+  size_t basic_rope<Summary>::depth(void) const {
+    if(this->root_ == nullptr)
+      return 0;
+    return this->root_->getDepth();
+  }
+  
+  // Get the structural statistics of the tree
+  template <typename Summary>
+  rope_stats basic_rope<Summary>::stats(void) const {
+    return getStats(this->root_);
+  }
+  
+  // Get the way in which the rope keeps its tree balanced
+  template <typename Summary>
+  balancing basic_rope<Summary>::balancingMode(void) const {
+    return this->balancing_;
+  }
+  
+  // Set the way in which the rope keeps its tree balanced
+  //
+  // Join balancing keeps an AVL tree balanced, so an unbalanced tree is first
+  //   rebuilt into one.
+  template <typename Summary>
+  void basic_rope<Summary>::setBalancingMode(balancing mode) {
+    this->balancing_ = mode;
+    if (mode == balancing::join && !this->isBalanced()) this->rebuild();
+  }
+  
+  // Get the given root, or a leaf holding the empty string if it is null
+  template <typename Summary>
+  node_handle<Summary> basic_rope<Summary>::orEmpty(handle root) {
+    return (root == nullptr) ? std::make_shared<const node>("") : root;
+  }
+  
+  // Rebuild the tree as a tree of minimal depth over its non-empty leaves, which is
+  //   also an AVL tree
+  template <typename Summary>
+  void basic_rope<Summary>::rebuild(void) {
+    this->root_ = orEmpty(minimalTree(this->root_));
+  }
+  
+  // Build a tree of minimal depth over the non-empty leaves of the given subtree, or
+  //   get null if it has none
+  template <typename Summary>
+  node_handle<Summary> basic_rope<Summary>::minimalTree(const handle& root) {
+    std::vector<handle> leaves;
+    getLeaves(root, leaves);
+    leaves.erase(std::remove_if(leaves.begin(), leaves.end(),
+      [](const handle& leaf) { return leaf->getLength() == 0; }), leaves.end());
+    return leaves.empty() ? nullptr : buildTree(leaves.data(), leaves.data() + leaves.size());
+  }
+  
+  // Get the given subtree for joining with concatBalanced
+  //
+  // concatBalanced keeps the depth of a join logarithmic only for balanced subtrees,
+  //   so a subtree built by appends in another rope (such as a long chain) would
+  //   otherwise be joined as it is, leaving its depth in the result.
+  template <typename Summary>
+  node_handle<Summary> basic_rope<Summary>::joinable(const handle& n) {
+    return (n == nullptr || n->getDepth() == 0 || fibBalanced(n)) ? n : minimalTree(n);
+  }
+  
+  // Replace the (len) chars beginning at index (start) with the given subtree
+  template <typename Summary>
+  void basic_rope<Summary>::spliceBalanced(size_t start, size_t len, const handle& text) {
+    PROJ_TRACE_SPAN("splitBalanced", this->length());
+    std::pair<handle, handle> firstSplit = splitBalanced(this->root_, start);
+    std::pair<handle, handle> secondSplit = splitBalanced(firstSplit.second, len);
+    this->root_ = orEmpty(concatBalanced(concatBalanced(firstSplit.first, text), secondSplit.second));
+  }
+  
+  // Get the policy under which the rope balances itself after edits
+  template <typename Summary>
+  rebalance_policy basic_rope<Summary>::rebalancePolicy(void) const {
+    return this->policy_;
+  }
+  
+  // Set the policy under which the rope balances itself after edits
+  template <typename Summary>
+  void basic_rope<Summary>::setRebalancePolicy(rebalance_policy policy) {
+    this->policy_ = policy;
+  }
+  
+  // Get the number of rebalances fired by the policy, and the time they took
+  template <typename Summary>
+  rebalance_stats basic_rope<Summary>::rebalanceStats(void) const {
+    return this->stats_;
+  }
+  
+  // Count an edit, balancing the rope if the rebalance policy calls for it
+  //
+  // Since balance() rebuilds only unbalanced subtrees, a rebalance fired after each
+  //   of a few edits costs time in proportion to the edited paths. The depth limit
+  //   should allow for the depth of a balanced tree over the rope's leaves.
+  template <typename Summary>
+  void basic_rope<Summary>::edited(void) {
+    this->editsSinceBalance_++;
+    bool due = false;
+    switch (this->policy_.trigger) {
+      case rebalance_trigger::never:
+        break;
+      case rebalance_trigger::depth:
+        due = this->root_->getDepth() > this->policy_.limit;
+        break;
+      case rebalance_trigger::edits:
+        due = this->editsSinceBalance_ >= this->policy_.limit;
+        break;
+      case rebalance_trigger::fibonacci:
+        // the empty string never satisfies isBalanced, but needs no balancing
+        due = this->length() > 0 && !this->isBalanced();
+        break;
+    }
+    if (!due) return;
+    auto start = std::chrono::steady_clock::now();
+    this->balance();
+    this->stats_.time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+    this->stats_.count++;
+  }
+  
+  // Determine if the given subtree satisfies the balance condition of isBalanced
+  //
+  // fib(d+2) exceeds the length of any string for d of 90 or more, so the condition
+  //   is decided without computing fib for the depths of long chains.
+  template <typename Summary>
+  bool basic_rope<Summary>::fibBalanced(const handle& n) {
+    size_t d = n->getDepth();
+    return d < 90 && n->getLength() >= fib(d+2);
+  }
+  
+  // Determine if the given subtree is near enough to the balance condition for
+  //   rebalanceLocal to mend it by rejoining its children
+  //
+  // A subtree more than twice as deep as the balance condition allows (as after a
+  //   long run of appends) is cheaper to mend by joining its balanced subtrees in
+  //   order than level by level, and this bound also limits how deep rebalanceLocal
+  //   recurses.
+  template <typename Summary>
+  bool basic_rope<Summary>::nearlyBalanced(const handle& n) {
+    return n->getDepth() <= 2 * maxBalancedDepth(n->getLength()) + 2;
+  }
+  
+  // Balance a rope
+  //
+  // Only the subtrees which are themselves unbalanced are rebuilt (see rebalanceLocal
+  //   in node.hpp), so the cost of balancing a rope after a few edits is proportional
+  //   to the edited paths rather than to the whole string. A subtree which rejoining
+  //   its children cannot balance is rebuilt as a tree of minimal depth over its
+  //   leaves, which (unlike the tree produced by concatenating leaves by Fibonacci
+  //   intervals) is an AVL tree, so that later joins above it stay balanced too.
+  //
+  // A rope using join balancing is rebuilt into a tree of minimal depth instead, so
+  //   that it remains an AVL tree.
+  template <typename Summary>
+  void basic_rope<Summary>::balance(void) {
+    PROJ_TIME_OP(balance);
+    PROJ_TRACE_SPAN("balance", this->length());
+    this->editsSinceBalance_ = 0;
+    if (this->balancing_ == balancing::join) {
+      if (!this->isBalanced()) this->rebuild();
+      return;
+    }
+    // initiate rebalancing only if rope is unbalanced
+    if(!this->isBalanced()) {
+      this->root_ = orEmpty(rebalanceLocal(this->root_, fibBalanced, nearlyBalanced, minimalTree));
+    }
+  }
+  
+  // Balance the rope by rebuilding it as a tree of minimal depth over its leaves
+  //
+  // The leaves of separate subtrees are collected concurrently, and the new tree is
+  //   then built bottom-up with its lower levels divided between threads. A tree of
+  //   minimal depth over n non-empty leaves has depth ceil(log2 n) and so always
+  //   satisfies isBalanced.
+  template <typename Summary>
+  void basic_rope<Summary>::balanceParallel(task_pool& pool) {
+    using leaf_list = std::vector<handle>;
+    PROJ_TRACE_SPAN("balanceParallel", this->length());
+    this->editsSinceBalance_ = 0;
+    if(this->isBalanced()) return;
     
-  }; // class rope
+    size_t len = this->length();
+    leaf_list leaves = parallelReduce<leaf_list>(this->root_, 0, pool.grainSize(len), pool,
+      [](const handle& n, size_t) {
+        leaf_list result;
+        getLeaves(n, result);
+        // ignore empty leaf nodes
+        result.erase(std::remove_if(result.begin(), result.end(),
+          [](const handle& leaf) { return leaf->getLength() == 0; }), result.end());
+        return result;
+      },
+      [](leaf_list l, leaf_list r) {
+        l.insert(l.end(), std::make_move_iterator(r.begin()), std::make_move_iterator(r.end()));
+        return l;
+      });
+    
+    if (leaves.empty()) {
+      this->root_ = std::make_shared<const node>("");
+    } else {
+      // divide the leaves in the same proportion as the chars
+      size_t grain = std::max(size_t(1), leaves.size() / std::max(size_t(1), len / pool.grainSize(len)));
+      this->root_ = buildTreeParallel(leaves.data(), leaves.data() + leaves.size(), grain, pool);
+    }
+  }
   
-  size_t fib(size_t n);
-  std::vector<size_t> buildFibList(size_t len);
+  // Assignment operator
+  template <typename Summary>
+  basic_rope<Summary>& basic_rope<Summary>::operator=(const basic_rope& rhs) {
+    // share the tree of the assigned rope, releasing the existing tree
+    this->root_ = rhs.root_;
+    this->balancing_ = rhs.balancing_;
+    this->policy_ = rhs.policy_;
+    this->editsSinceBalance_ = rhs.editsSinceBalance_;
+    this->stats_ = rhs.stats_;
+    return *this;
+  }
+  
+  // Determine if two ropes contain identical strings
+  template <typename Summary>
+  bool basic_rope<Summary>::operator ==(const basic_rope& rhs) const {
+    return this->toString() == rhs.toString();
+  }
   
+  // Determine if two ropes contain identical strings
+  template <typename Summary>
+  bool basic_rope<Summary>::operator !=(const basic_rope& rhs) const {
+    return !(*this == rhs);
+  }
+  
+  // Print the rope
+  template <typename Summary>
+  std::ostream& operator<<(std::ostream& out, const basic_rope<Summary>& r) {
+    return out << r.toString();
+  }
+  
+  extern template class basic_rope<no_summary>;
+
 } // namespace proj
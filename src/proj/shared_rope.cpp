@@ -0,0 +1,15 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "shared_rope.hpp"
+
+namespace proj
+{
+  // Instantiate the shared default rope
+  template class basic_shared_rope<no_summary>;
+
+} // namespace proj
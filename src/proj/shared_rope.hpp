@@ -0,0 +1,199 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "epoch.hpp"
+#include "rope.hpp"
+
+namespace proj
+{
+  // A shared_rope is a rope which may be read by any number of threads while
+  //   another thread edits it
+  //
+  // Each edit is made to a private copy of the current version, which shares all but
+  //   the rebuilt nodes with it, and the result is then published with a single
+  //   atomic store. Readers never take a lock: they pin the current epoch, load the
+  //   published version and read it in place, so a read always sees one complete
+  //   version. Writers are serialised with one another by a mutex.
+  //
+  // An unpublished version is destroyed only once every reader which could have
+  //   loaded it has finished, as determined by epoch-based reclamation.
+  
+  template <typename Summary>
+  class basic_shared_rope {
+  
+  public:
+    
+    using rope_type = basic_rope<Summary>;
+    
+    // CONSTRUCTORS
+    // Construct a shared rope whose initial version is the given rope
+    basic_shared_rope(const rope_type& initial = rope_type());
+    basic_shared_rope(const basic_shared_rope&) = delete;
+    basic_shared_rope& operator=(const basic_shared_rope&) = delete;
+    // Destroy every version; no thread may be reading the shared rope
+    ~basic_shared_rope(void);
+    
+    // ACCESSORS
+    // Get a copy of the current version, which is unaffected by later edits
+    rope_type snapshot(void) const;
+    // Apply the given function to the current version in place, returning its result
+    //   The version must not be referenced after the function returns
+    template <typename F>
+    auto read(F f) const -> decltype(f(std::declval<const rope_type&>()));
+    // Get the number of unpublished versions awaiting destruction
+    size_t retiredCount(void) const;
+    
+    // MUTATORS
+    // Apply the given function to a copy of the current version and publish the result
+    template <typename F>
+    void update(F f);
+    // Publish the given rope as the current version
+    void store(const rope_type& r);
+    // Insert the given string at the given position of the current version
+    void insert(size_t i, const string& str);
+    // Append the given string to the current version
+    void append(const string& str);
+    // Delete the substring of (len) chars beginning at index start of the current version
+    void rdelete(size_t start, size_t len);
+  
+  private:
+    
+    // An unpublished version and the epoch in which it was retired
+    struct retired {
+      const rope_type * text;
+      uint64_t epoch;
+    };
+    
+    // Publish the given version, retiring the version it replaces; requires lock_
+    void publish(const rope_type * next);
+    // Destroy the retired versions which no reader can still reference; requires lock_
+    void reclaim(void);
+    
+    std::atomic<const rope_type *> current_;
+    mutable std::mutex lock_;
+    std::vector<retired> retired_;
+  
+  }; // class basic_shared_rope
+  
+  using shared_rope = basic_shared_rope<no_summary>;
+  
+  // Construct a shared rope whose initial version is the given rope
+  template <typename Summary>
+  basic_shared_rope<Summary>::basic_shared_rope(const rope_type& initial)
+    : current_(new rope_type(initial))
+  {}
+  
+  // Destroy every version
+  template <typename Summary>
+  basic_shared_rope<Summary>::~basic_shared_rope(void) {
+    for (const retired& r : this->retired_) delete r.text;
+    delete this->current_.load();
+  }
+  
+  // Get a copy of the current version
+  //
+  // Copying a rope only shares its root, so the copy is made while pinned and takes
+  //   O(1) time.
+  template <typename Summary>
+  basic_rope<Summary> basic_shared_rope<Summary>::snapshot(void) const {
+    epoch_guard guard;
+    return *this->current_.load();
+  }
+  
+  // Apply the given function to the current version in place
+  template <typename Summary>
+  template <typename F>
+  auto basic_shared_rope<Summary>::read(F f) const -> decltype(f(std::declval<const rope_type&>())) {
+    epoch_guard guard;
+    return f(*this->current_.load());
+  }
+  
+  // Get the number of unpublished versions awaiting destruction
+  template <typename Summary>
+  size_t basic_shared_rope<Summary>::retiredCount(void) const {
+    std::lock_guard<std::mutex> hold(this->lock_);
+    return this->retired_.size();
+  }
+  
+  // Apply the given function to a copy of the current version and publish the result
+  //
+  // Writers hold the lock for the whole update, so the copy is always made from the
+  //   latest version and no edit is lost.
+  template <typename Summary>
+  template <typename F>
+  void basic_shared_rope<Summary>::update(F f) {
+    std::lock_guard<std::mutex> hold(this->lock_);
+    rope_type * next = new rope_type(*this->current_.load());
+    try {
+      f(*next);
+    } catch (...) {
+      delete next;
+      throw;
+    }
+    this->publish(next);
+  }
+  
+  // Publish the given rope as the current version
+  template <typename Summary>
+  void basic_shared_rope<Summary>::store(const rope_type& r) {
+    std::lock_guard<std::mutex> hold(this->lock_);
+    this->publish(new rope_type(r));
+  }
+  
+  // Insert the given string at the given position of the current version
+  template <typename Summary>
+  void basic_shared_rope<Summary>::insert(size_t i, const string& str) {
+    this->update([&](rope_type& r) { r.insert(i, str); });
+  }
+  
+  // Append the given string to the current version
+  template <typename Summary>
+  void basic_shared_rope<Summary>::append(const string& str) {
+    this->update([&](rope_type& r) { r.append(str); });
+  }
+  
+  // Delete the substring of (len) chars beginning at index start of the current version
+  template <typename Summary>
+  void basic_shared_rope<Summary>::rdelete(size_t start, size_t len) {
+    this->update([&](rope_type& r) { r.rdelete(start, len); });
+  }
+  
+  // Publish the given version, retiring the version it replaces
+  //
+  // The epoch is advanced after the replaced version is unpublished, so any reader
+  //   pinned in a later epoch loads the new version.
+  template <typename Summary>
+  void basic_shared_rope<Summary>::publish(const rope_type * next) {
+    const rope_type * prev = this->current_.exchange(next);
+    this->retired_.push_back(retired{prev, retireEpoch()});
+    this->reclaim();
+  }
+  
+  // Destroy the retired versions which no reader can still reference
+  template <typename Summary>
+  void basic_shared_rope<Summary>::reclaim(void) {
+    uint64_t oldest = oldestPinnedEpoch();
+    size_t kept = 0;
+    for (const retired& r : this->retired_) {
+      if (r.epoch < oldest) {
+        delete r.text;
+      } else {
+        this->retired_[kept++] = r;
+      }
+    }
+    this->retired_.resize(kept);
+  }
+  
+  extern template class basic_shared_rope<no_summary>;
+
+} // namespace proj
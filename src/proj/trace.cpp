@@ -0,0 +1,166 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include "trace.hpp"
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace proj
+{
+  std::atomic<bool> tracingEnabled(false);
+  
+  // The events recorded by a single thread
+  //
+  // Each buffer has a lock of its own, which only its thread takes while recording,
+  //   so that recording does not contend with other threads but a trace may be
+  //   written at any time. When a thread exits, its events are moved to the retired
+  //   buffers, so that they are still written, and its buffer is freed.
+  struct trace_buffer {
+    std::mutex lock;
+    std::vector<trace_event> events;
+    size_t tid;
+  };
+  
+  // The buffers of running threads, the events of threads which have exited, the
+  //   last thread id given out, and the time at which tracing began
+  static std::mutex registryLock;
+  static std::vector<trace_buffer *> buffers;
+  static std::vector<std::unique_ptr<trace_buffer>> retired;
+  static size_t lastTid = 0;
+  static std::atomic<std::chrono::steady_clock::rep> origin(0);
+  
+  // The buffer of the calling thread, or null if it has none
+  static thread_local trace_buffer * currentBuffer = nullptr;
+  // Whether the calling thread has exited, and its buffer been retired
+  static thread_local bool bufferRetired = false;
+  
+  // Owns the buffer of a thread, whose events are moved to the retired buffers on the
+  //   thread's exit
+  struct trace_buffer_owner {
+    std::unique_ptr<trace_buffer> buffer;
+    trace_buffer_owner(void) : buffer(new trace_buffer) {
+      std::lock_guard<std::mutex> hold(registryLock);
+      this->buffer->tid = ++lastTid;
+      buffers.push_back(this->buffer.get());
+    }
+    ~trace_buffer_owner(void) {
+      std::lock_guard<std::mutex> hold(registryLock);
+      buffers.erase(std::find(buffers.begin(), buffers.end(), this->buffer.get()));
+      if (!this->buffer->events.empty()) {
+        this->buffer->events.shrink_to_fit();
+        retired.push_back(std::move(this->buffer));
+      }
+      currentBuffer = nullptr;
+      bufferRetired = true;
+    }
+  };
+  
+  // Get the buffer of the calling thread, registering it on first use, or null if the
+  //   thread is exiting and its buffer has been retired
+  static trace_buffer * threadBuffer(void) {
+    if (currentBuffer == nullptr && !bufferRetired) {
+      static thread_local trace_buffer_owner owner;
+      currentBuffer = owner.buffer.get();
+    }
+    return currentBuffer;
+  }
+  
+  // Discard any recorded events and begin recording
+  void startTracing(void) {
+    std::lock_guard<std::mutex> hold(registryLock);
+    retired.clear();
+    for (trace_buffer * b : buffers) {
+      std::lock_guard<std::mutex> holdBuffer(b->lock);
+      b->events.clear();
+    }
+    origin.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    tracingEnabled.store(true);
+  }
+  
+  // Stop recording; the recorded events are kept until tracing next begins
+  void stopTracing(void) {
+    tracingEnabled.store(false);
+  }
+  
+  // Get the nanoseconds elapsed since tracing began
+  uint64_t traceClock(void) {
+    std::chrono::steady_clock::duration elapsed(
+      std::chrono::steady_clock::now().time_since_epoch().count() - origin.load(std::memory_order_relaxed));
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  }
+  
+  // Record the given event on the calling thread
+  //
+  // An event recorded by a thread after its buffer was retired (as by the destructor
+  //   of another thread-local object) is dropped.
+  void traceEvent(const trace_event& e) {
+    trace_buffer * b = threadBuffer();
+    if (b == nullptr) return;
+    std::lock_guard<std::mutex> hold(b->lock);
+    b->events.push_back(e);
+  }
+  
+  // Record an instant event for an allocation of the given number of bytes
+  void traceAllocation(uint64_t bytes) {
+    traceEvent(trace_event{ "allocate", 'i', traceClock(), 0, bytes });
+  }
+  
+  // Write a time in nanoseconds as the microseconds of the trace format
+  static void writeMicros(std::ostream& out, uint64_t ns) {
+    out << ns / 1000 << '.';
+    uint64_t frac = ns % 1000;
+    out << static_cast<char>('0' + frac / 100) << static_cast<char>('0' + frac / 10 % 10)
+      << static_cast<char>('0' + frac % 10);
+  }
+  
+  // Write the events of the given buffer, whose lock must be held, as events of a
+  //   Chrome trace, each preceded by a comma unless it is the first written
+  static void writeEvents(std::ostream& out, const trace_buffer& b, bool& first) {
+    for (const trace_event& e : b.events) {
+      out << (first ? "\n" : ",\n") << "{\"name\":\"" << e.name << "\",\"cat\":\"rope\",\"ph\":\""
+        << e.phase << "\",\"ts\":";
+      writeMicros(out, e.startNs);
+      if (e.phase == 'X') {
+        out << ",\"dur\":";
+        writeMicros(out, e.durationNs);
+      } else {
+        out << ",\"s\":\"t\"";
+      }
+      out << ",\"pid\":1,\"tid\":" << b.tid << ",\"args\":{\"bytes\":" << e.bytes << "}}";
+      first = false;
+    }
+  }
+  
+  // Write the recorded events of every thread, running or exited, as a Chrome trace
+  //
+  // Event names are string literals chosen by the library, so need no escaping.
+  void writeTrace(std::ostream& out) {
+    std::lock_guard<std::mutex> hold(registryLock);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& b : retired) writeEvents(out, *b, first);
+    for (trace_buffer * b : buffers) {
+      std::lock_guard<std::mutex> holdBuffer(b->lock);
+      writeEvents(out, *b, first);
+    }
+    out << "\n]}\n";
+  }
+  
+  // Write the recorded events to the file at the given path, returning whether the
+  //   file was written
+  bool writeTraceFile(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) return false;
+    writeTrace(out);
+    return static_cast<bool>(out);
+  }
+
+} // namespace proj
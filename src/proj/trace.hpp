@@ -0,0 +1,100 @@
+//
+// Copyright Will Roever 2016 - 2017.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace proj
+{
+  // Event tracing
+  //
+  // When built with PROJ_TRACE_EVENTS defined (the CMake option of the same name,
+  //   off by default), ropes record spans for their internal steps (splits,
+  //   balancing and flattening copies) and instant events for the nodes they
+  //   allocate, each with a size in bytes. Events are recorded only between
+  //   startTracing and stopTracing, and writeTrace writes them in the Chrome trace
+  //   event format, which chrome://tracing and Perfetto open directly. Otherwise
+  //   nothing is recorded and the ropes pay nothing.
+  
+  // An event recorded by a thread; times are in nanoseconds since tracing began
+  struct trace_event {
+    // a string literal naming the event
+    const char * name;
+    // 'X' for a span, 'i' for an instant event
+    char phase;
+    uint64_t startNs;
+    uint64_t durationNs;
+    uint64_t bytes;
+  };
+  
+  // Discard any recorded events and begin recording
+  void startTracing(void);
+  // Stop recording; the recorded events are kept until tracing next begins
+  void stopTracing(void);
+  // Determine whether events are being recorded
+  inline bool tracing(void);
+  // Get the nanoseconds elapsed since tracing began
+  uint64_t traceClock(void);
+  // Record the given event on the calling thread
+  void traceEvent(const trace_event& e);
+  // Record an instant event for an allocation of the given number of bytes
+  void traceAllocation(uint64_t bytes);
+  // Write the recorded events of every thread as a Chrome trace
+  void writeTrace(std::ostream& out);
+  // Write the recorded events to the file at the given path, returning whether the
+  //   file was written
+  bool writeTraceFile(const std::string& path);
+  
+  // set while events are being recorded
+  extern std::atomic<bool> tracingEnabled;
+  
+  inline bool tracing(void) {
+    return tracingEnabled.load(std::memory_order_relaxed);
+  }
+  
+  // Records the lifetime of the span as an event with the given name, if events are
+  //   being recorded when it begins
+  class trace_span {
+  
+  public:
+    
+    trace_span(const char * name, uint64_t bytes)
+      : name_(tracing() ? name : nullptr), bytes_(bytes), start_(name_ ? traceClock() : 0)
+    {}
+    ~trace_span(void) {
+      if (this->name_ != nullptr) {
+        traceEvent(trace_event{ this->name_, 'X', this->start_, traceClock() - this->start_, this->bytes_ });
+      }
+    }
+    trace_span(const trace_span&) = delete;
+    trace_span& operator=(const trace_span&) = delete;
+  
+  private:
+    
+    const char * name_;
+    uint64_t bytes_;
+    uint64_t start_;
+  
+  }; // class trace_span
+
+} // namespace proj
+
+// Trace the rest of the enclosing scope as a span with the given name and size, and
+//   trace an allocation of the given size, if event tracing is enabled
+#ifdef PROJ_TRACE_EVENTS
+#define PROJ_TRACE_SPAN(name, bytes) ::proj::trace_span proj_trace_span_(name, bytes)
+#define PROJ_TRACE_ALLOC(bytes) do { if (::proj::tracing()) ::proj::traceAllocation(bytes); } while (0)
+#else
+#define PROJ_TRACE_SPAN(name, bytes)
+#define PROJ_TRACE_ALLOC(bytes)
+#endif
@@ -0,0 +1,210 @@
+#include "proj/rope.hpp"
+#include "proj/builder.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <UnitTest++/TimeHelpers.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+// Empirical complexity tests
+//
+// Each test times an operation on balanced ropes of geometrically increasing
+//   sizes, fits a power law t = c * n^k to the times by least squares on their
+//   logarithms, and fails if the exponent k exceeds the bound for the operation's
+//   complexity. Between the smallest and the largest size O(log n) grows by a
+//   factor of about 3.5 over a factor of 1024 in n, an exponent of under 0.2,
+//   while O(n) has an exponent of 1, so the bounds tell linear growth from
+//   logarithmic reliably; they cannot tell O(log n) from O(1).
+//
+// To resist machine noise every time is the least of several repetitions, each
+//   running the operation for at least 2 ms, and operations visit a few fixed
+//   positions, so that the paths they follow stay in cache at every size. A fit
+//   exceeding its bound is retried, and the test fails only if every attempt does.
+
+namespace proj
+{
+  using std::string;
+  using std::vector;
+  
+  // the greatest exponents allowed for operations of each complexity
+  const double CONSTANT = 0.25;
+  const double LOGARITHMIC = 0.5;
+  
+  const size_t MIN_BYTES = 1 << 12;
+  const size_t MAX_BYTES = 1 << 22;
+  const size_t LEAF_BYTES = 256;
+  const size_t POSITIONS = 16;
+  const size_t REPETITIONS = 5;
+  const size_t ATTEMPTS = 3;
+  
+  // Written by every timed operation so that its result is not optimized away
+  volatile size_t sink;
+  
+  // A document of each size, built once for every test
+  struct document {
+    rope text;
+    vector<size_t> positions;
+  };
+  
+  const vector<document>& documents(void) {
+    static vector<document> docs;
+    if (docs.empty()) {
+      for (size_t bytes = MIN_BYTES; bytes <= MAX_BYTES; bytes *= 4) {
+        rope_builder builder;
+        string leaf(LEAF_BYTES, 'a');
+        for (size_t i = 0; i < bytes; i += LEAF_BYTES) {
+          leaf[0] = static_cast<char>('a' + (i / LEAF_BYTES) % 26);
+          builder.append(leaf);
+        }
+        document doc{ builder.build(), vector<size_t>() };
+        // spread the positions across the document, away from its end
+        for (size_t i = 0; i < POSITIONS; i++) doc.positions.push_back((bytes - 64) * i / POSITIONS);
+        docs.push_back(std::move(doc));
+      }
+    }
+    return docs;
+  }
+  
+  // Get the least mean time in nanoseconds of op(doc, pos) over several repetitions
+  double nsPerOp(const document& doc, const std::function<void(const rope&, size_t)>& op) {
+    double best = 0;
+    for (size_t r = 0; r < REPETITIONS; r++) {
+      size_t iterations = 0;
+      UnitTest::Timer timer;
+      timer.Start();
+      double ms = 0;
+      for (size_t batch = 16; ms < 2; batch *= 2) {
+        for (size_t i = 0; i < batch; i++) op(doc.text, doc.positions[(iterations + i) % POSITIONS]);
+        iterations += batch;
+        ms = timer.GetTimeInMs();
+      }
+      double ns = ms * 1e6 / iterations;
+      if (r == 0 || ns < best) best = ns;
+    }
+    return best;
+  }
+  
+  // Fit t = c * n^k to the times of the given operation, and get the exponent k
+  double growthExponent(const std::function<void(const rope&, size_t)>& op) {
+    vector<double> x, y;
+    for (const document& doc : documents()) {
+      x.push_back(std::log(static_cast<double>(doc.text.length())));
+      y.push_back(std::log(nsPerOp(doc, op)));
+    }
+    double mx = 0, my = 0;
+    for (size_t i = 0; i < x.size(); i++) mx += x[i], my += y[i];
+    mx /= x.size(), my /= y.size();
+    double sxy = 0, sxx = 0;
+    for (size_t i = 0; i < x.size(); i++) {
+      sxy += (x[i] - mx) * (y[i] - my);
+      sxx += (x[i] - mx) * (x[i] - mx);
+    }
+    return sxy / sxx;
+  }
+  
+  // Determine whether the growth of the given operation stays within the bound,
+  //   reporting the exponent found if it does not
+  bool growsWithin(const char * name, double bound, const std::function<void(const rope&, size_t)>& op) {
+    double exponent = 0;
+    for (size_t attempt = 0; attempt < ATTEMPTS; attempt++) {
+      exponent = growthExponent(op);
+      if (exponent <= bound) return true;
+    }
+    std::printf("%s grows as n^%.2f, faster than the bound of n^%.2f\n", name, exponent, bound);
+    return false;
+  }
+  
+  // a ceiling on the time taken to fit any one operation, however it grows
+  const int FIT_TIME_LIMIT_MS = 30000;
+  
+  TEST(LENGTH_GROWTH) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growsWithin("length", LOGARITHMIC, [](const rope& r, size_t) { sink = r.length(); }));
+  }
+  
+  TEST(DEPTH_GROWTH) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growsWithin("depth", CONSTANT, [](const rope& r, size_t) { sink = r.depth(); }));
+  }
+  
+  TEST(COPY_GROWTH) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growsWithin("copy", CONSTANT, [](const rope& r, size_t) { rope copy = r; sink = copy.depth(); }));
+  }
+  
+  TEST(AT_GROWTH) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growsWithin("at", LOGARITHMIC, [](const rope& r, size_t pos) { sink = r.at(pos); }));
+  }
+  
+  TEST(SUBSTRING_GROWTH) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growsWithin("substring", LOGARITHMIC, [](const rope& r, size_t pos) {
+      sink = r.substring(pos, 64).length();
+    }));
+  }
+  
+  TEST(INSERT_GROWTH) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growsWithin("insert", LOGARITHMIC, [](const rope& r, size_t pos) {
+      rope copy = r;
+      copy.insert(pos, "inserted");
+      sink = copy.depth();
+    }));
+  }
+  
+  TEST(RDELETE_GROWTH) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growsWithin("rdelete", LOGARITHMIC, [](const rope& r, size_t pos) {
+      rope copy = r;
+      copy.rdelete(pos, 8);
+      sink = copy.depth();
+    }));
+  }
+  
+  TEST(APPEND_GROWTH) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growsWithin("append", CONSTANT, [](const rope& r, size_t) {
+      rope copy = r;
+      copy.append("appended");
+      sink = copy.depth();
+    }));
+  }
+  
+  TEST(JOIN_INSERT_GROWTH) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growsWithin("insert with join balancing", LOGARITHMIC, [](const rope& r, size_t pos) {
+      rope copy = r;
+      copy.setBalancingMode(balancing::join);
+      copy.insert(pos, "inserted");
+      sink = copy.depth();
+    }));
+  }
+  
+  TEST(SPLIT_GROWTH) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growsWithin("split", LOGARITHMIC, [](const rope& r, size_t pos) {
+      sink = r.split(pos).first.depth();
+    }));
+  }
+  
+  TEST(IS_BALANCED_GROWTH) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growsWithin("isBalanced", LOGARITHMIC, [](const rope& r, size_t) { sink = r.isBalanced(); }));
+  }
+  
+  // a linear operation must fail the bound, or the fit could not catch a regression
+  TEST(LINEAR_GROWTH_DETECTED) {
+    UNITTEST_TIME_CONSTRAINT(FIT_TIME_LIMIT_MS);
+    CHECK(growthExponent([](const rope& r, size_t) { sink = r.toString().length(); }) > LOGARITHMIC);
+  }
+
+}  // namespace proj
+
+int
+main(int, const char* [])
+{
+    return UnitTest::RunAllTests();
+}
@@ -1,6 +1,16 @@
 #include "proj/rope.hpp"
+#include "proj/alloc_count.hpp"
+#include "proj/builder.hpp"
+#include "proj/history.hpp"
+#include "proj/latency.hpp"
+#include "proj/recorder.hpp"
+#include "proj/shared_rope.hpp"
+#include "proj/trace.hpp"
 #include <UnitTest++/UnitTest++.h>
+#include <atomic>
+#include <random>
 #include <sstream>
+#include <thread>
 #include <utility>
 
 namespace proj
@@ -12,6 +22,40 @@ namespace proj
   string str2 = "Here is a much longer string for testing!";
   string paragraph1 = "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Maecenas sapien diam, maximus a mauris sed, posuere tincidunt tellus. Morbi sapien enim, vehicula sed imperdiet vel, pharetra vel lorem. Nullam pharetra justo ac elit varius, ut accumsan nisl eleifend. Mauris in condimentum augue. In consequat justo nunc, sit amet efficitur orci scelerisque at. Suspendisse ac ullamcorper urna, eget tincidunt risus. Suspendisse cursus nisl et volutpat ultrices. Integer posuere, diam vel tempus egestas, nisl leo tincidunt metus, nec semper risus nisl sit amet tortor. Morbi blandit sem sed nisi facilisis condimentum. Cras lacinia aliquet erat, nec finibus magna. Curabitur efficitur ante vitae efficitur vestibulum. Nam a accumsan urna, vitae consectetur lorem. Proin rutrum ultrices sapien ac tincidunt. Phasellus semper vel leo quis semper.";
   
+  // summary counting the code points of a UTF-8 string, for use in testing
+  struct code_points {
+    size_t count;
+    code_points(void) : count(0) {}
+    explicit code_points(const string& str) : count(0) {
+      for (char c : str) if ((static_cast<unsigned char>(c) & 0xC0) != 0x80) count++;
+    }
+    code_points operator+(const code_points& rhs) const {
+      code_points result;
+      result.count = this->count + rhs.count;
+      return result;
+    }
+  };
+  
+  // summary of bracket nesting, for use in testing
+  //   (depth) is the net change in nesting and (minDepth) the lowest nesting reached
+  struct brackets {
+    long depth;
+    long minDepth;
+    brackets(void) : depth(0), minDepth(0) {}
+    explicit brackets(const string& str) : depth(0), minDepth(0) {
+      for (char c : str) {
+        if (c == '(') depth++;
+        if (c == ')') minDepth = std::min(minDepth, --depth);
+      }
+    }
+    brackets operator+(const brackets& rhs) const {
+      brackets result;
+      result.depth = this->depth + rhs.depth;
+      result.minDepth = std::min(this->minDepth, this->depth + rhs.minDepth);
+      return result;
+    }
+  };
+  
   // explode function for use in testing
   // usage: auto v = explode("hello world foo bar", ' ');
   vector<rope *> explode(const string& str, char delim) {
@@ -208,6 +252,13 @@ namespace proj
     CHECK_EQUAL("This", r1.substring(0,4));
     CHECK_EQUAL("test.", r1.substring(10,5));
     CHECK_EQUAL(" elit. Maecenas sapien diam, maximus a mauris sed,", rParagraph.substring(50,50));
+    
+    // test substrings spanning several leaves
+    rope rPieces = rope("abc");
+    rPieces.append("defgh");
+    rPieces.append("ijk");
+    CHECK_EQUAL("bcdefghij", rPieces.substring(1,9));
+    CHECK_EQUAL("efghijk", rPieces.substring(4,7));
 
   }
   
@@ -263,12 +314,14 @@ namespace proj
     rope rA = rope("a");
     
     CHECK(rF.isBalanced());
+    CHECK_EQUAL(size_t(0), rF.depth());
     
     rope r1 = rope(str1);
     CHECK(r1.isBalanced());
     
     rF.insert(0,rE);
     CHECK(!rF.isBalanced());
+    CHECK_EQUAL(size_t(2), rF.depth());
 
     rF.insert(0,rD);
     rF.insert(0,rC);
@@ -304,6 +357,1082 @@ namespace proj
     reapExploded(exploded);
   }
   
+  TEST(UTF16_CONVERSION) {
+    // "a", U+00E9 (2 bytes), U+20AC (3 bytes), U+1F600 (4 bytes, surrogate pair), "b"
+    string utf8 = "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80" "b";
+    rope r = rope(utf8);
+    CHECK_EQUAL(11, r.length());
+    CHECK_EQUAL(6, r.utf16Length());
+    
+    CHECK_EQUAL(0, r.byteToUtf16(0));
+    CHECK_EQUAL(1, r.byteToUtf16(1));
+    CHECK_EQUAL(2, r.byteToUtf16(3));
+    CHECK_EQUAL(3, r.byteToUtf16(6));
+    CHECK_EQUAL(5, r.byteToUtf16(10));
+    CHECK_EQUAL(6, r.byteToUtf16(11));
+    CHECK_THROW(r.byteToUtf16(12), std::invalid_argument);
+    
+    CHECK_EQUAL(0, r.utf16ToByte(0));
+    CHECK_EQUAL(3, r.utf16ToByte(2));
+    CHECK_EQUAL(6, r.utf16ToByte(3));
+    // an offset inside a surrogate pair maps to the start of the code point
+    CHECK_EQUAL(6, r.utf16ToByte(4));
+    CHECK_EQUAL(10, r.utf16ToByte(5));
+    CHECK_EQUAL(11, r.utf16ToByte(6));
+    CHECK_THROW(r.utf16ToByte(7), std::invalid_argument);
+    
+    // split multi-byte sequences across leaves and check the counts still agree
+    rope rSplit = rope(utf8);
+    rSplit.rdelete(8, 1);
+    rSplit.insert(8, "\x98");
+    rSplit.rdelete(2, 1);
+    rSplit.insert(2, "\xA9");
+    CHECK_EQUAL(utf8, rSplit.toString());
+    CHECK_EQUAL(6, rSplit.utf16Length());
+    for (size_t i = 0; i <= 6; i++) {
+      CHECK_EQUAL(r.utf16ToByte(i), rSplit.utf16ToByte(i));
+    }
+    for (size_t i = 0; i <= utf8.length(); i++) {
+      CHECK_EQUAL(r.byteToUtf16(i), rSplit.byteToUtf16(i));
+    }
+  }
+  
+  TEST(LINE_CONVERSION) {
+    rope rEmpty = rope();
+    CHECK_EQUAL(1, rEmpty.lineCount());
+    CHECK_EQUAL(0, rEmpty.lineToByte(0));
+    CHECK_THROW(rEmpty.lineToByte(1), std::invalid_argument);
+    
+    rope r = rope("first\n");
+    r.append("sec\xC3\xA9ond\nthi");
+    r.append("rd \xF0\x9F\x98\x80!\n");
+    CHECK_EQUAL(4, r.lineCount());
+    CHECK_EQUAL(0, r.lineToByte(0));
+    CHECK_EQUAL(6, r.lineToByte(1));
+    CHECK_EQUAL(15, r.lineToByte(2));
+    CHECK_EQUAL(27, r.lineToByte(3));
+    
+    CHECK_EQUAL(0, r.byteToLine(5));
+    CHECK_EQUAL(1, r.byteToLine(6));
+    CHECK_EQUAL(2, r.byteToLine(26));
+    CHECK_EQUAL(3, r.byteToLine(27));
+    
+    // (line, UTF-16 column) positions
+    std::pair<size_t, size_t> pos = r.byteToLineUtf16(11);
+    CHECK_EQUAL(1, pos.first);
+    CHECK_EQUAL(4, pos.second);
+    pos = r.byteToLineUtf16(25);
+    CHECK_EQUAL(2, pos.first);
+    CHECK_EQUAL(8, pos.second);
+    CHECK_EQUAL(11, r.lineUtf16ToByte(1, 4));
+    CHECK_EQUAL(21, r.lineUtf16ToByte(2, 6));
+    CHECK_EQUAL(25, r.lineUtf16ToByte(2, 8));
+    // columns past the end of a line clamp to the end of the line
+    CHECK_EQUAL(14, r.lineUtf16ToByte(1, 100));
+    CHECK_EQUAL(27, r.lineUtf16ToByte(3, 5));
+  }
+  
+  TEST(SUMMARY) {
+    basic_rope<code_points> r = basic_rope<code_points>("na\xC3\xAFve");
+    CHECK_EQUAL(5, r.summary().count);
+    
+    // summaries are maintained through insertion, deletion and balancing
+    r.insert(0, "a ");
+    r.append(" caf\xC3\xA9");
+    r.insert(2, basic_rope<code_points>("tr\xC3\xA8s "));
+    CHECK_EQUAL("a tr\xC3\xA8s na\xC3\xAFve caf\xC3\xA9", r.toString());
+    CHECK_EQUAL(17, r.summary().count);
+    r.rdelete(0, 2);
+    CHECK_EQUAL(15, r.summary().count);
+    r.balance();
+    CHECK_EQUAL(15, r.summary().count);
+    
+    CHECK_EQUAL(0, r.prefixSummary(0).count);
+    CHECK_EQUAL(3, r.prefixSummary(4).count);
+    CHECK_EQUAL(15, r.prefixSummary(r.length()).count);
+    CHECK_THROW(r.prefixSummary(r.length() + 1), std::invalid_argument);
+    
+    // find the byte index of the 9th code point
+    size_t index = r.seek([](const code_points& s) { return s.count > 8; });
+    CHECK_EQUAL(10, index - 1);
+    CHECK_EQUAL('v', r.at(index - 1));
+    CHECK_EQUAL(string::npos, r.seek([](const code_points& s) { return s.count > 15; }));
+  }
+  
+  TEST(SUMMARY_SEEK) {
+    basic_rope<brackets> r = basic_rope<brackets>("(a(b)");
+    r.append("c)d)");
+    r.append("(e))");
+    CHECK_EQUAL(-2, r.summary().depth);
+    CHECK_EQUAL(-2, r.summary().minDepth);
+    
+    // locate the first unmatched closing bracket
+    size_t index = r.seek([](const brackets& s) { return s.minDepth < 0; });
+    CHECK_EQUAL(')', r.at(index - 1));
+    CHECK_EQUAL(8, index - 1);
+    
+    // every prefix satisfies a predicate satisfied by the empty string
+    CHECK_EQUAL(0, r.seek([](const brackets& s) { return s.minDepth <= 0; }));
+  }
+  
+  TEST(APPLY_EDITS) {
+    rope r = rope("The quick brown fox");
+    r.append(" jumps over");
+    r.append(" the lazy dog.");
+    
+    // test out-of-range and misordered edits, which leave the rope untouched
+    CHECK_THROW(r.applyEdits({{40, 5, ""}}), std::invalid_argument);
+    CHECK_THROW(r.applyEdits({{45, 0, "x"}}), std::invalid_argument);
+    CHECK_THROW(r.applyEdits({{10, 5, ""}, {12, 0, "x"}}), std::invalid_argument);
+    CHECK_THROW(r.applyEdits({{10, 0, ""}, {4, 0, "x"}}), std::invalid_argument);
+    CHECK_EQUAL("The quick brown fox jumps over the lazy dog.", r.toString());
+    
+    // offsets refer to the original string, and edits may span leaves
+    r.applyEdits({
+      {0, 3, "A"},
+      {10, 5, "red"},
+      {16, 9, "leaps"},
+      {30, 0, ","},
+      {35, 0, "very "},
+      {43, 0, "!"},
+      {44, 0, "?"}
+    });
+    CHECK_EQUAL("A quick red leaps over, the very lazy dog!.?", r.toString());
+    
+    // compare against edits applied one at a time, last to first, to a std::string
+    std::mt19937 gen(42);
+    vector<rope *> exploded = explode(paragraph1, ' ');
+    rope rParagraph = rope();
+    for (rope * word : exploded) {
+      rParagraph.append(*word);
+      rParagraph.append(" ");
+    }
+    reapExploded(exploded);
+    string expected = rParagraph.toString();
+    vector<rope::edit> edits;
+    size_t offset = 0;
+    while (true) {
+      offset += gen() % 40;
+      size_t len = gen() % 12;
+      if (offset + len > expected.length()) break;
+      edits.push_back({offset, len, string(gen() % 4, 'A' + gen() % 26)});
+      offset += len;
+    }
+    for (auto e = edits.rbegin(); e != edits.rend(); e++) {
+      expected.replace(e->offset, e->deleteLen, e->insertText);
+    }
+    rParagraph.applyEdits(edits);
+    CHECK_EQUAL(expected, rParagraph.toString());
+    CHECK_EQUAL(expected.length(), rParagraph.length());
+  }
+  
+  TEST(INSERT_AT_ALL) {
+    rope r = rope("int a;\nint b;");
+    r.append("\nint c;\n");
+    
+    // test out-of-range and unsorted positions
+    CHECK_THROW(r.insertAtAll({0, 22}, "x"), std::invalid_argument);
+    CHECK_THROW(r.insertAtAll({7, 0}, "x"), std::invalid_argument);
+    
+    // comment out every line, including one at a leaf boundary and the empty last line
+    r.insertAtAll({0, 7, 14, 21}, "// ");
+    CHECK_EQUAL("// int a;\n// int b;\n// int c;\n// ", r.toString());
+    CHECK_EQUAL(33, r.length());
+    CHECK_EQUAL(4, r.lineCount());
+    
+    // repeated positions insert repeatedly, and a rope may be inserted into itself
+    rope rAb = rope("ab");
+    rAb.insertAtAll({1, 1, 2}, "-");
+    CHECK_EQUAL("a--b-", rAb.toString());
+    rAb.insertAtAll({0, 5}, rAb);
+    CHECK_EQUAL("a--b-a--b-a--b-", rAb.toString());
+    
+    rope rEmpty = rope();
+    rEmpty.insertAtAll({}, "x");
+    rEmpty.insertAtAll({0}, "x");
+    CHECK_EQUAL("x", rEmpty.toString());
+  }
+  
+  TEST(SHARED_COPY) {
+    rope r1 = rope(str1);
+    r1.append(str2);
+    rope r2 = r1;
+    rope r3;
+    r3 = r1;
+    
+    // edits to a copy do not affect the ropes it shares nodes with
+    r2.insert(4, "!");
+    r3.rdelete(0, 5);
+    r1.balance();
+    CHECK_EQUAL(str1 + str2, r1.toString());
+    CHECK_EQUAL("This!" + str1.substr(4) + str2, r2.toString());
+    CHECK_EQUAL(str1.substr(5) + str2, r3.toString());
+    
+    // a rope may be inserted into and appended to itself
+    r3 = rope("ab");
+    r3.insert(1, r3);
+    r3.append(r3);
+    CHECK_EQUAL("aabbaabb", r3.toString());
+  }
+  
+  TEST(HISTORY) {
+    rope_history h = rope_history(rope(str1));
+    CHECK_EQUAL(0, h.version());
+    CHECK(!h.canUndo());
+    CHECK(!h.canRedo());
+    CHECK_THROW(h.undo(), std::invalid_argument);
+    
+    rope r = h.current();
+    r.insert(4, "!");
+    CHECK_EQUAL(1, h.commit(r));
+    r.rdelete(0, 4);
+    CHECK_EQUAL(2, h.commit(r));
+    CHECK_EQUAL("!_is_a_test.", h.current().toString());
+    
+    CHECK_EQUAL("This!_is_a_test.", h.undo().toString());
+    CHECK_EQUAL(str1, h.undo().toString());
+    CHECK(!h.canUndo());
+    CHECK_EQUAL("This!_is_a_test.", h.redo().toString());
+    CHECK_EQUAL("!_is_a_test.", h.jumpTo(2).toString());
+    CHECK_EQUAL(str1, h.jumpTo(0).toString());
+    CHECK_THROW(h.jumpTo(3), std::invalid_argument);
+    
+    // committing after an undo discards the versions which could have been redone
+    h.jumpTo(1);
+    r = h.current();
+    r.append("?");
+    CHECK_EQUAL(2, h.commit(r));
+    CHECK(!h.canRedo());
+    CHECK_EQUAL("This!_is_a_test.?", h.current().toString());
+  }
+  
+  TEST(HISTORY_BUDGET) {
+    // a small edit to a large rope retains far less memory than the rope occupies
+    rope r = rope(paragraph1);
+    for (size_t i = 0; i < 6; i++) r.append(r);
+    r.balance();
+    size_t len = r.length();
+    rope_history h = rope_history(r);
+    r.insert(len / 2, "x");
+    h.commit(r);
+    CHECK(h.memoryUsage() > 0);
+    CHECK(h.memoryUsage() < len / 10);
+    
+    // an unchanged rope retains nothing
+    size_t usage = h.memoryUsage();
+    h.commit(r);
+    CHECK_EQUAL(usage, h.memoryUsage());
+    
+    // the oldest versions are dropped once the budget is exceeded
+    for (size_t i = 0; i < 20; i++) {
+      r.rdelete(i * 100, 1);
+      h.commit(r);
+    }
+    CHECK_EQUAL(0, h.oldestVersion());
+    CHECK_EQUAL(22, h.newestVersion());
+    h.setBudget(h.memoryUsage() / 2);
+    CHECK(h.memoryUsage() <= h.budget());
+    CHECK(h.oldestVersion() > 0);
+    CHECK_EQUAL(22, h.version());
+    CHECK_EQUAL(r.toString(), h.current().toString());
+    
+    // the current version is retained even when it alone exceeds the budget
+    h.setBudget(0);
+    CHECK_EQUAL(0, h.memoryUsage());
+    CHECK_EQUAL(22, h.oldestVersion());
+    
+    // the memory of a chain too deep to recurse over is measured
+    rope chain = rope("");
+    chain.setRebalancePolicy({ rebalance_trigger::never, 0 });
+    rope_history chainHistory = rope_history(chain);
+    for (size_t i = 0; i < 200000; i++) chain.append(str1);
+    chainHistory.commit(chain);
+    CHECK(chainHistory.memoryUsage() > str1.length() * 200000);
+    CHECK_EQUAL(chain.length(), chainHistory.current().length());
+  }
+  
+  TEST(SHARED_ROPE) {
+    shared_rope s{rope(str1)};
+    rope before = s.snapshot();
+    s.insert(4, "!");
+    s.append("?");
+    s.rdelete(0, 4);
+    CHECK_EQUAL("!_is_a_test.?", s.snapshot().toString());
+    CHECK_EQUAL(13, s.read([](const rope& r) { return r.length(); }));
+    // snapshots are unaffected by later edits
+    CHECK_EQUAL(str1, before.toString());
+    // a failed update publishes nothing
+    CHECK_THROW(s.update([](rope& r) { r.rdelete(100, 1); }), std::invalid_argument);
+    CHECK_EQUAL("!_is_a_test.?", s.snapshot().toString());
+    
+    // no reader is pinned, so replaced versions are destroyed immediately
+    CHECK_EQUAL(0, s.retiredCount());
+    // versions replaced while a reader is pinned are kept until it finishes
+    s.read([&](const rope& r) {
+      s.store(rope(str2));
+      s.store(rope(str1));
+      CHECK_EQUAL("!_is_a_test.?", r.toString());
+      CHECK_EQUAL(2, s.retiredCount());
+      return 0;
+    });
+    s.append("!");
+    CHECK_EQUAL(0, s.retiredCount());
+    CHECK_EQUAL(str1 + "!", s.snapshot().toString());
+  }
+  
+  TEST(SHARED_ROPE_CONCURRENT) {
+    // the writer appends pairs of chars, so every published version has even length
+    //   and alternates between the two chars
+    shared_rope s;
+    std::atomic<bool> done(false);
+    std::atomic<size_t> torn(0);
+    vector<std::thread> readers;
+    for (size_t t = 0; t < 4; t++) {
+      readers.push_back(std::thread([&] {
+        while (!done.load()) {
+          s.read([&](const rope& r) {
+            size_t len = r.length();
+            if (len % 2 != 0 || (len > 0 && (r.at(0) != 'a' || r.at(len - 1) != 'b'))) torn++;
+            return len;
+          });
+        }
+      }));
+    }
+    for (size_t i = 0; i < 2000; i++) {
+      s.append("ab");
+      if (i % 100 == 0) s.update([](rope& r) { r.balance(); });
+    }
+    done.store(true);
+    for (std::thread& t : readers) t.join();
+    CHECK_EQUAL(0, torn.load());
+    CHECK_EQUAL(4000, s.snapshot().length());
+  }
+  
+  TEST(SHARED_ROPE_SNAPSHOT_DROP) {
+    // readers drop snapshots, sometimes holding the last reference to nodes, while the
+    //   writer splits the same nodes; each is destroyed only by its last owner
+    shared_rope s{rope(paragraph1)};
+    std::atomic<bool> done(false);
+    std::atomic<size_t> shortened(0);
+    vector<std::thread> readers;
+    for (size_t t = 0; t < 4; t++) {
+      readers.push_back(std::thread([&] {
+        while (!done.load()) {
+          rope snapshot = s.snapshot();
+          if (snapshot.length() < paragraph1.length()) shortened++;
+        }
+      }));
+    }
+    for (size_t i = 0; i < 2000; i++) {
+      s.insert((i * 7919) % (paragraph1.length() + i * 2), "ab");
+      if (i % 100 == 0) s.update([](rope& r) { r.balance(); });
+    }
+    done.store(true);
+    for (std::thread& t : readers) t.join();
+    CHECK_EQUAL(0, shortened.load());
+    CHECK_EQUAL(paragraph1.length() + 4000, s.snapshot().length());
+  }
+  
+  TEST(PARALLEL_FLATTEN) {
+    task_pool pool(4);
+    CHECK_EQUAL("", rope().toStringParallel(pool));
+    CHECK_EQUAL(str1, rope(str1).toStringParallel(pool));
+    
+    // large enough to be divided between threads, with leaves of uneven length
+    rope r = rope(paragraph1);
+    for (size_t i = 0; i < 10; i++) r.append(r);
+    for (size_t i = 0; i < 50; i++) r.insert(i * 7919, str2);
+    string expected = r.toString();
+    CHECK(expected.length() > 8 * MIN_PARALLEL_GRAIN);
+    for (size_t threads : {1, 2, 3, 8}) {
+      task_pool p(threads);
+      CHECK(expected == r.toStringParallel(p));
+    }
+    string buffer(r.length(), '\0');
+    r.copyTo(&buffer[0]);
+    CHECK(expected == buffer);
+  }
+  
+  TEST(PARALLEL_BALANCE) {
+    // a long chain of small appends, divided between threads
+    rope r = rope("");
+    string expected;
+    for (size_t i = 0; i < 20000; i++) {
+      string piece = str1.substr(0, 1 + i % str1.length());
+      r.append(piece);
+      expected += piece;
+    }
+    CHECK(!r.isBalanced());
+    for (size_t threads : {1, 2, 8}) {
+      task_pool pool(threads);
+      rope copy = r;
+      copy.balanceParallel(pool);
+      CHECK(copy.isBalanced());
+      CHECK(expected == copy.toString());
+    }
+    
+    // empty leaves are dropped
+    rope e = rope("");
+    e.append("");
+    e.append("ab");
+    e.append("");
+    e.balanceParallel();
+    CHECK(e.isBalanced());
+    CHECK_EQUAL("ab", e.toString());
+  }
+  
+  TEST(FIND) {
+    rope r = rope("abc");
+    r.append("abca");
+    r.append("bc");
+    CHECK_EQUAL(0, r.find("abc"));
+    CHECK_EQUAL(3, r.find("abc", 1));
+    CHECK_EQUAL(6, r.find("abc", 4));
+    CHECK_EQUAL(string::npos, r.find("abc", 7));
+    CHECK_EQUAL(string::npos, r.find("abcd"));
+    CHECK_EQUAL(4, r.find("", 4));
+    CHECK_EQUAL(3, r.countParallel("abc"));
+    CHECK_EQUAL(2, rope("aaa").countParallel("aa"));
+  }
+  
+  TEST(PARALLEL_FIND) {
+    // build a rope whose search ranges are divided between threads, placing
+    //   matches on either side of, and across, range boundaries
+    string text(16 * MIN_PARALLEL_GRAIN + 37, '.');
+    for (size_t i = MIN_PARALLEL_GRAIN / 3; i + 10 < text.length(); i += MIN_PARALLEL_GRAIN / 3 + 1) {
+      text.replace(i, 6, "needle");
+    }
+    rope r = rope("");
+    for (size_t i = 0; i < text.length(); i += 1000) r.append(text.substr(i, 1000));
+    
+    vector<size_t> expected;
+    for (size_t i = text.find("needle"); i != string::npos; i = text.find("needle", i + 1)) {
+      expected.push_back(i);
+    }
+    for (size_t threads : {1, 3, 8}) {
+      task_pool pool(threads);
+      CHECK(expected == r.findAllParallel("needle", pool));
+      CHECK_EQUAL(expected.size(), r.countParallel("needle", pool));
+      CHECK_EQUAL(expected.front(), r.findParallel("needle", pool));
+      CHECK_EQUAL(string::npos, r.findParallel("haystack", pool));
+    }
+    CHECK_EQUAL(expected[5], r.find("needle", expected[4] + 1));
+    
+    // a single match straddling every possible boundary is found exactly once
+    string dots(8 * MIN_PARALLEL_GRAIN, '.');
+    for (size_t at : {MIN_PARALLEL_GRAIN - 3, 4 * MIN_PARALLEL_GRAIN - 1, 8 * MIN_PARALLEL_GRAIN - 6}) {
+      string t = dots;
+      t.replace(at, 6, "needle");
+      rope s = rope(t);
+      task_pool pool(4);
+      CHECK_EQUAL(1, s.countParallel("needle", pool));
+      CHECK_EQUAL(at, s.findParallel("needle", pool));
+      CHECK_EQUAL(at, s.find("needle"));
+    }
+  }
+  
+  TEST(TASK_POOL) {
+    // nested forks from inside and outside the pool all complete
+    for (size_t threads : {1, 2, 4}) {
+      task_pool pool(threads);
+      CHECK_EQUAL(threads, pool.threadCount());
+      vector<size_t> hits(1000, 0);
+      pool.parallelFor(10, [&](size_t i) {
+        pool.parallelFor(100, [&](size_t j) { hits[i * 100 + j]++; });
+      });
+      CHECK(std::all_of(hits.begin(), hits.end(), [](size_t h) { return h == 1; }));
+      
+      // exceptions reach the caller once both functions have finished
+      bool finished = false;
+      CHECK_THROW(pool.invoke([] { throw std::runtime_error("a"); }, [&] { finished = true; }),
+                  std::runtime_error);
+      CHECK(finished);
+    }
+    
+    // small ropes are not divided between threads
+    task_pool pool(4);
+    CHECK_EQUAL(MIN_PARALLEL_GRAIN, pool.grainSize(100));
+    CHECK_EQUAL((size_t(1) << 30) / 32, pool.grainSize(size_t(1) << 30));
+  }
+  
+  TEST(BUILDER) {
+    rope_builder b(16);
+    CHECK_EQUAL(0, b.length());
+    CHECK_EQUAL("", b.build().toString());
+    
+    // small pieces are packed into leaves, and long pieces divided between them
+    string expected;
+    for (size_t i = 0; i < 1000; i++) {
+      string piece = str1.substr(i % str1.length(), i % 5);
+      b.append(piece);
+      expected += piece;
+    }
+    b.append(paragraph1.data(), 100);
+    expected.append(paragraph1, 0, 100);
+    b.append(rope(str2));
+    expected += str2;
+    rope r = rope(paragraph1);
+    r.append(str1);
+    b.append(r);
+    expected += paragraph1 + str1;
+    CHECK_EQUAL(expected.length(), b.length());
+    
+    rope built = b.build();
+    CHECK(built.isBalanced());
+    CHECK_EQUAL(expected, built.toString());
+    CHECK_EQUAL(expected.length(), built.length());
+    CHECK_EQUAL(countNewlines(expected, 0, expected.length()), built.lineCount() - 1);
+    
+    // the builder is reset once the rope is built
+    CHECK_EQUAL(0, b.length());
+    b.append(str1);
+    CHECK_EQUAL(str1, b.build().toString());
+  }
+  
+  TEST(SPLIT_AND_CONCAT) {
+    rope r = rope(str1);
+    auto pieces = r.split(4);
+    CHECK_EQUAL("This", pieces.first.toString());
+    CHECK_EQUAL("_is_a_test.", pieces.second.toString());
+    pieces = r.split(0);
+    CHECK_EQUAL("", pieces.first.toString());
+    CHECK_EQUAL(str1, pieces.second.toString());
+    CHECK_THROW(r.split(100), std::invalid_argument);
+    CHECK_EQUAL(str1 + str2, rope::concat(rope(str1), rope(str2)).toString());
+    CHECK_EQUAL(str1, rope::concat(rope(), rope(str1)).toString());
+    
+    // concatenating one piece at a time keeps the rope balanced, where appending
+    //   builds a chain
+    rope built = rope("");
+    string expected;
+    for (size_t i = 0; i < 5000; i++) {
+      string piece = str2.substr(i % str2.length(), 1 + i % 3);
+      built = rope::concat(std::move(built), rope(piece));
+      expected += piece;
+    }
+    CHECK(built.isBalanced());
+    CHECK_EQUAL(expected, built.toString());
+    
+    // splitting and rejoining at every point yields balanced pieces
+    std::mt19937 gen(7);
+    for (size_t i = 0; i < 200; i++) {
+      size_t at = gen() % (expected.length() + 1);
+      pieces = built.split(at);
+      CHECK(pieces.first.isBalanced());
+      CHECK(pieces.second.isBalanced());
+      CHECK(expected.substr(0, at) == pieces.first.toString());
+      // cut a piece from the middle and paste it at the front
+      size_t len = std::min(size_t(50), pieces.second.length());
+      auto cut = pieces.second.split(len);
+      built = rope::concat(std::move(cut.first), rope::concat(std::move(pieces.first), std::move(cut.second)));
+      expected = expected.substr(at, len) + expected.substr(0, at) + expected.substr(at + len);
+      CHECK(built.isBalanced());
+    }
+    CHECK(expected == built.toString());
+  }
+  
+  TEST(JOIN_BALANCING) {
+    rope r = rope("");
+    CHECK(r.balancingMode() == balancing::rebuild);
+    r.setBalancingMode(balancing::join);
+    rope copy = r;
+    CHECK(copy.balancingMode() == balancing::join);
+    
+    // random edits keep the rope balanced without any call to balance
+    std::mt19937 gen(11);
+    string expected;
+    for (size_t i = 0; i < 3000; i++) {
+      size_t op = gen() % 4;
+      size_t pos = gen() % (expected.length() + 1);
+      string text = str2.substr(gen() % str2.length(), 1 + gen() % 4);
+      if (op == 0) {
+        r.append(text);
+        expected += text;
+      } else if (op == 1 || expected.empty()) {
+        r.insert(pos, text);
+        expected.insert(pos, text);
+      } else {
+        size_t len = std::min(expected.length() - std::min(pos, expected.length()), size_t(1 + gen() % 6));
+        pos = std::min(pos, expected.length() - len);
+        r.rdelete(pos, len);
+        expected.erase(pos, len);
+      }
+      CHECK(expected.empty() || r.isBalanced());
+    }
+    CHECK(expected == r.toString());
+    
+    // batched edits and splits preserve the mode and the balance
+    r.applyEdits({{0, 3, "xyz"}, {10, 0, "!"}, {20, 5, ""}});
+    expected.replace(20, 5, "");
+    expected.insert(10, "!");
+    expected.replace(0, 3, "xyz");
+    r.insertAtAll({1, 2, 3}, "-");
+    expected.insert(3, "-");
+    expected.insert(2, "-");
+    expected.insert(1, "-");
+    CHECK(expected == r.toString());
+    CHECK(r.isBalanced());
+    auto pieces = r.split(expected.length() / 2);
+    CHECK(pieces.first.balancingMode() == balancing::join);
+    
+    // switching an unbalanced rope to join balancing rebuilds it
+    rope chain = rope("");
+    for (size_t i = 0; i < 100; i++) chain.append(str1);
+    CHECK(!chain.isBalanced());
+    chain.setBalancingMode(balancing::join);
+    CHECK(chain.isBalanced());
+    chain.append(str1);
+    CHECK(chain.isBalanced());
+    
+    // a deep chain from a rope using rebuild balancing is rebuilt before it is joined
+    rope deep = rope("");
+    for (size_t i = 0; i < 2000; i++) deep.append(str1);
+    CHECK(!deep.isBalanced());
+    rope joined = rope(str2);
+    joined.setBalancingMode(balancing::join);
+    joined.append(deep);
+    CHECK(joined.isBalanced());
+    joined.insert(5, deep);
+    CHECK(joined.isBalanced());
+    joined.insertAtAll({0, 7}, deep);
+    CHECK(joined.isBalanced());
+    CHECK(joined.depth() < 40);
+    CHECK_EQUAL(str2.length() + 4 * deep.length(), joined.length());
+    string deepText = deep.toString();
+    string joinedText = str2 + deepText;
+    joinedText.insert(5, deepText);
+    joinedText.insert(7, deepText);
+    joinedText.insert(0, deepText);
+    CHECK(joinedText == joined.toString());
+    rope both = rope::concat(rope(deep), rope(deep));
+    CHECK(both.isBalanced());
+    CHECK(deepText + deepText == both.toString());
+  }
+  
+  TEST(REBALANCE_POLICY) {
+    // the default policy never balances of its own accord
+    rope r = rope("");
+    CHECK(r.rebalancePolicy().trigger == rebalance_trigger::never);
+    for (size_t i = 0; i < 50; i++) r.append(str1);
+    CHECK(!r.isBalanced());
+    CHECK_EQUAL(size_t(0), r.rebalanceStats().count);
+    
+    // the Fibonacci trigger keeps the rope balanced after every edit
+    rope fibRope = rope("");
+    fibRope.setRebalancePolicy({ rebalance_trigger::fibonacci, 0 });
+    for (size_t i = 0; i < 50; i++) {
+      fibRope.insert(fibRope.length() / 2, str1);
+      CHECK(fibRope.isBalanced());
+    }
+    CHECK(fibRope.rebalanceStats().count > 0);
+    CHECK(fibRope.rebalanceStats().count < 50);
+    CHECK(fibRope.rebalanceStats().time.count() >= 0);
+    
+    // the edits trigger fires once every (limit) edits
+    rope editRope = rope(str2);
+    editRope.setRebalancePolicy({ rebalance_trigger::edits, 10 });
+    for (size_t i = 0; i < 35; i++) editRope.rdelete(0, 1);
+    CHECK_EQUAL(size_t(3), editRope.rebalanceStats().count);
+    CHECK_EQUAL(str2.substr(35), editRope.toString());
+    
+    // the depth trigger bounds the depth of the tree
+    rope depthRope = rope("");
+    depthRope.setRebalancePolicy({ rebalance_trigger::depth, 8 });
+    for (size_t i = 0; i < 200; i++) depthRope.append(str2);
+    CHECK(depthRope.rebalanceStats().count > 0);
+    CHECK(depthRope.isBalanced());
+    
+    // copies share the policy and the counters of the original
+    rope copy = fibRope;
+    CHECK(copy.rebalancePolicy().trigger == rebalance_trigger::fibonacci);
+    CHECK_EQUAL(fibRope.rebalanceStats().count, copy.rebalanceStats().count);
+  }
+  
+  TEST(LOCAL_REBALANCE) {
+    // balancing after each edit to a balanced rope keeps it balanced
+    rope_builder builder(8);
+    for (size_t i = 0; i < 200; i++) builder.append(str2);
+    rope r = builder.build();
+    string expected = r.toString();
+    CHECK(r.isBalanced());
+    std::mt19937 gen(5);
+    for (size_t i = 0; i < 500; i++) {
+      size_t pos = gen() % expected.length();
+      if (i % 3 == 2) {
+        size_t len = std::min(expected.length() - pos, size_t(1 + gen() % 20));
+        r.rdelete(pos, len);
+        expected.erase(pos, len);
+      } else {
+        r.insert(pos, str1);
+        expected.insert(pos, str1);
+      }
+      r.balance();
+      CHECK(r.isBalanced());
+    }
+    CHECK(expected == r.toString());
+    
+    // a long chain is rebalanced by rejoining its pieces
+    rope chain = rope("");
+    for (size_t i = 0; i < 2000; i++) chain.append(str1);
+    chain.balance();
+    CHECK(chain.isBalanced());
+    CHECK_EQUAL(str1.length() * 2000, chain.length());
+    
+    // a chain far deeper than the stack could recurse over is rebuilt directly
+    rope deep = rope("");
+    deep.setRebalancePolicy({ rebalance_trigger::never, 0 });
+    for (size_t i = 0; i < 200000; i++) deep.append(str1);
+    CHECK_EQUAL(size_t(200000), deep.depth());
+    deep.balance();
+    CHECK(deep.isBalanced());
+    CHECK_EQUAL(str1.length() * 200000, deep.length());
+    
+    // the empty rope balances to the empty rope
+    rope empty = rope("");
+    empty.balance();
+    CHECK_EQUAL(string(""), empty.toString());
+  }
+  
+  TEST(ALLOCATION_BUDGETS) {
+    // every budget must hold for small and large ropes alike, since the allocations
+    //   of each operation should depend on the depth of the tree and not its size
+    for (size_t pieces : { size_t(100), size_t(100000) }) {
+      rope_builder builder(64);
+      for (size_t i = 0; i < pieces; i++) builder.append(str1);
+      rope big = builder.build();
+      size_t depth = big.depth();
+      
+      // reads and copies do not allocate
+      {
+        alloc_scope scope;
+        rope copy = big;
+        CHECK_EQUAL('T', copy.at(0));
+        copy.balance();
+        CHECK_EQUAL(size_t(0), scope.counts().allocations);
+      }
+      // appending a rope allocates a single node, however long the rope
+      {
+        rope r = rope(str2);
+        alloc_scope scope;
+        r.append(big);
+        CHECK(scope.counts().allocations <= 1);
+        CHECK(scope.counts().bytes < 1024);
+      }
+      // an edit allocates nodes only along the edited path
+      {
+        rope r = big;
+        alloc_scope scope;
+        r.insert(r.length() / 3, str1);
+        CHECK(scope.counts().allocations <= depth + 8);
+      }
+      {
+        rope r = big;
+        alloc_scope scope;
+        r.rdelete(r.length() / 3, 20);
+        CHECK(scope.counts().allocations <= 2 * depth + 12);
+      }
+      {
+        rope r = big;
+        r.setBalancingMode(balancing::join);
+        alloc_scope scope;
+        r.insert(r.length() / 3, str1);
+        r.rdelete(r.length() / 2, 20);
+        CHECK(scope.counts().allocations <= 8 * depth + 16);
+      }
+      // a substring allocates only the string returned
+      {
+        alloc_scope scope;
+        string sub = big.substring(big.length() / 2, 100);
+        CHECK_EQUAL(size_t(1), scope.counts().allocations);
+      }
+    }
+  }
+  
+  TEST(STATS) {
+    rope r = rope("abc");
+    r.append("defgh");
+    r.append(rope(""));
+    rope_stats stats = r.stats();
+    CHECK_EQUAL(size_t(5), stats.nodes);
+    CHECK_EQUAL(size_t(3), stats.leaves);
+    CHECK_EQUAL(size_t(1), stats.emptyLeaves);
+    CHECK_EQUAL(size_t(2), stats.depth);
+    CHECK_EQUAL(size_t(8), stats.textBytes);
+    // each node costs at least itself and its two reference counts
+    CHECK(stats.overheadBytes >= stats.nodes * (sizeof(rope_node) + 2 * sizeof(int)));
+    // "abc" has 2 to 3 chars and "defgh" has 4 to 7
+    CHECK_EQUAL(size_t(3), stats.leafSizes.size());
+    CHECK_EQUAL(size_t(0), stats.leafSizes[0]);
+    CHECK_EQUAL(size_t(1), stats.leafSizes[1]);
+    CHECK_EQUAL(size_t(1), stats.leafSizes[2]);
+    CHECK_EQUAL(size_t(0), stats.sharedNodes);
+    
+    // every node of a copied rope is shared, and an edit to the copy shares all
+    //   but the nodes it builds
+    rope copy = r;
+    CHECK_EQUAL(size_t(5), r.stats().sharedNodes);
+    copy.append("ij");
+    CHECK_EQUAL(size_t(7), copy.stats().nodes);
+    CHECK_EQUAL(size_t(5), copy.stats().sharedNodes);
+    CHECK_EQUAL(size_t(5), r.stats().sharedNodes);
+    copy = rope("");
+    CHECK_EQUAL(size_t(0), r.stats().sharedNodes);
+    
+    // the walk handles chains too deep to recurse over
+    rope chain = rope("");
+    chain.setRebalancePolicy({ rebalance_trigger::never, 0 });
+    for (size_t i = 0; i < 200000; i++) chain.append(str1);
+    rope_stats chainStats = chain.stats();
+    CHECK_EQUAL(size_t(200000), chainStats.depth);
+    CHECK_EQUAL(size_t(400001), chainStats.nodes);
+    CHECK_EQUAL(str1.length() * 200000, chainStats.textBytes);
+  }
+  
+  TEST(OP_RECORDER) {
+    for (bool redact : { false, true }) {
+      std::stringstream stream;
+      op_recorder recorder(stream, str1, redact);
+      recording_rope r(rope(str1), recorder);
+      r.insert(3, "abc");
+      r.append(str2);
+      r.rdelete(1, 4);
+      CHECK_EQUAL('s', r.at(5));
+      CHECK_EQUAL("Tcs_", r.substring(0, 4));
+      // operations which throw are not recorded
+      CHECK_THROW(r.rdelete(r.length(), 1), std::invalid_argument);
+      string expected = r.current().toString();
+      
+      op_reader reader(stream);
+      CHECK_EQUAL(redact, reader.redacted());
+      CHECK_EQUAL(redact ? string(str1.length(), 'x') : str1, reader.initial());
+      rope replayed = rope(reader.initial());
+      std::vector<recorded_op> ops;
+      recorded_op op;
+      uint64_t lastTime = 0;
+      while (reader.next(op)) {
+        CHECK(op.timeNs >= lastTime);
+        lastTime = op.timeNs;
+        playOp(replayed, op);
+        ops.push_back(op);
+      }
+      CHECK_EQUAL(5u, ops.size());
+      CHECK(ops[0].kind == recorded_op_kind::insert);
+      CHECK_EQUAL(3u, ops[0].pos);
+      CHECK_EQUAL(redact ? "xxx" : "abc", ops[0].text);
+      CHECK(ops[1].kind == recorded_op_kind::append);
+      CHECK_EQUAL(str2.length(), ops[1].len);
+      CHECK(ops[2].kind == recorded_op_kind::rdelete);
+      CHECK_EQUAL(4u, ops[2].len);
+      CHECK(ops[3].kind == recorded_op_kind::at);
+      CHECK_EQUAL(5u, ops[3].pos);
+      CHECK(ops[4].kind == recorded_op_kind::substring);
+      CHECK_EQUAL(4u, ops[4].len);
+      CHECK_EQUAL(expected.length(), replayed.length());
+      if (!redact) CHECK_EQUAL(expected, replayed.toString());
+    }
+    
+    // anything but a complete recording is rejected
+    std::stringstream notRecording("not a recording");
+    CHECK_THROW(op_reader bad(notRecording), std::invalid_argument);
+    std::stringstream full;
+    {
+      op_recorder recorder(full, "", false);
+      recorder.record(recorded_op_kind::insert, 0, 5, "hello");
+    }
+    string bytes = full.str();
+    std::stringstream truncated(bytes.substr(0, bytes.length() - 2));
+    op_reader reader(truncated);
+    recorded_op op;
+    CHECK_THROW(reader.next(op), std::invalid_argument);
+    
+    // as is a redacted recording asking for more filler than the limit, or an
+    //   operation outside the replayed document
+    std::stringstream huge;
+    {
+      op_recorder recorder(huge, "hello", true);
+      recorder.record(recorded_op_kind::insert, 0, size_t(1) << 62);
+    }
+    CHECK_THROW(op_reader tooLong(huge, 4), std::invalid_argument);
+    huge.seekg(0);
+    op_reader hugeReader(huge);
+    CHECK_THROW(hugeReader.next(op), std::invalid_argument);
+    std::stringstream outside;
+    {
+      op_recorder recorder(outside, "hello", true);
+      recorder.record(recorded_op_kind::rdelete, 3, 2);
+      recorder.record(recorded_op_kind::at, 3, 0);
+    }
+    op_reader outsideReader(outside);
+    CHECK(outsideReader.next(op));
+    CHECK_THROW(outsideReader.next(op), std::invalid_argument);
+  }
+  
+  TEST(SERIALIZE) {
+    // the shape of the tree is kept, along with its text
+    rope r = rope(str1);
+    r.append(str2);
+    r.insert(5, "inserted");
+    r.rdelete(20, 3);
+    r.append(r);
+    std::stringstream stream;
+    r.serialize(stream);
+    rope loaded = rope::deserialize(stream);
+    CHECK_EQUAL(r.toString(), loaded.toString());
+    CHECK_EQUAL(r.depth(), loaded.depth());
+    rope_stats before = r.stats(), after = loaded.stats();
+    CHECK_EQUAL(before.nodes, after.nodes);
+    CHECK_EQUAL(before.leaves, after.leaves);
+    // the subtree appended to itself is written once for each occurrence
+    CHECK_EQUAL(32 + 32 * before.nodes + before.textBytes, stream.str().length());
+    CHECK_EQUAL(size_t(0), after.sharedNodes);
+    loaded.insert(3, "abc");
+    CHECK_EQUAL(r.toString().insert(3, "abc"), loaded.toString());
+    
+    for (const rope& original : { rope(), rope(""), rope(str2) }) {
+      std::stringstream s;
+      original.serialize(s);
+      CHECK_EQUAL(original.toString(), rope::deserialize(s).toString());
+    }
+    
+    // anything but a complete serialized rope is rejected
+    std::stringstream notRope("not a serialized rope, but long enough for a header");
+    CHECK_THROW(rope::deserialize(notRope), std::invalid_argument);
+    string bytes = stream.str();
+    std::stringstream truncated(bytes.substr(0, bytes.length() - 1));
+    CHECK_THROW(rope::deserialize(truncated), std::invalid_argument);
+    // a leaf whose text lies outside the text section
+    std::stringstream badLeaf;
+    rope(str1).serialize(badLeaf);
+    string leaf = badLeaf.str();
+    leaf[32] = 1;  // the offset of the only leaf
+    std::stringstream corrupt(leaf);
+    CHECK_THROW(rope::deserialize(corrupt), std::invalid_argument);
+    
+    // tables which are not a single tree over the text, or whose counts are wrong
+    auto load = [](const vector<vector<uint64_t>>& entries, const string& text) {
+      string bytes = "PROJROPE";
+      putU64(bytes, 1);
+      putU64(bytes, entries.size());
+      putU64(bytes, text.length());
+      for (const vector<uint64_t>& entry : entries) {
+        for (uint64_t v : entry) putU64(bytes, v);
+      }
+      std::stringstream in(bytes + text);
+      return rope::deserialize(in);
+    };
+    CHECK_EQUAL("a\nb", load({ { 0, 2 | LEAF_BIT, 2, 1 }, { 2, 1 | LEAF_BIT, 1, 0 }, { 0, 1, 0, 0 } }, "a\nb").toString());
+    // a leaf used as both children, and a self-join whose length would overflow
+    CHECK_THROW(load({ { 0, 1 | LEAF_BIT, 1, 0 }, { 0, 0, 0, 0 } }, "a"), std::invalid_argument);
+    vector<vector<uint64_t>> chain = { { 0, 1 | LEAF_BIT, 1, 0 } };
+    for (uint64_t i = 1; i <= 70; i++) chain.push_back({ i - 1, i - 1, 0, 0 });
+    CHECK_THROW(load(chain, "a"), std::invalid_argument);
+    // a node which is the child of two others
+    CHECK_THROW(load({ { 0, 1 | LEAF_BIT, 1, 0 }, { 1, 1 | LEAF_BIT, 1, 0 }, { 0, 1, 0, 0 }, { 2, 1, 0, 0 } }, "ab"),
+      std::invalid_argument);
+    // a node which is the child of none, but is not the root
+    CHECK_THROW(load({ { 0, LEAF_BIT, 0, 0 }, { 0, 1 | LEAF_BIT, 1, 0 }, { 1, 1 | LEAF_BIT, 1, 0 }, { 1, 2, 0, 0 } }, "ab"),
+      std::invalid_argument);
+    // an internal node lacking a right child
+    CHECK_THROW(load({ { 0, 1 | LEAF_BIT, 1, 0 }, { 0, LEAF_BIT - 1, 0, 0 } }, "a"), std::invalid_argument);
+    // wrong UTF-16 and newline counts
+    CHECK_THROW(load({ { 0, 3 | LEAF_BIT, 3, 0 } }, "a\nb"), std::invalid_argument);
+    CHECK_THROW(load({ { 0, 3 | LEAF_BIT, 2, 1 } }, "a\nb"), std::invalid_argument);
+  }
+  
+  TEST(LATENCY_HISTOGRAM) {
+    // every latency falls in a bucket whose range holds it, to within 12.5%
+    for (uint64_t ns : { uint64_t(0), uint64_t(15), uint64_t(16), uint64_t(1000), uint64_t(123456789) }) {
+      size_t bucket = latency_histogram::bucketOf(ns);
+      CHECK(ns <= latency_histogram::bucketMax(bucket));
+      CHECK(latency_histogram::bucketMax(bucket) - ns <= ns / 8);
+      CHECK(bucket == 0 || latency_histogram::bucketMax(bucket - 1) < ns);
+    }
+    CHECK(latency_histogram::bucketOf(~uint64_t(0)) < latency_histogram::BUCKETS);
+    
+    latency_histogram h;
+    CHECK_EQUAL(uint64_t(0), h.percentile(0.5));
+    for (uint64_t ns = 1; ns <= 100; ns++) h.record(ns * 100);
+    CHECK_EQUAL(uint64_t(100), h.count());
+    CHECK(h.percentile(0.5) >= 5000 && h.percentile(0.5) <= 5000 * 9 / 8);
+    CHECK(h.percentile(0.99) >= 9900 && h.percentile(0.99) <= 9900 * 9 / 8);
+    
+    latency_histogram other;
+    other.record(1);
+    h.merge(other);
+    CHECK_EQUAL(uint64_t(101), h.count());
+    h.subtract(other);
+    CHECK_EQUAL(uint64_t(100), h.count());
+    
+#ifdef PROJ_LATENCY_HISTOGRAMS
+    // ropes record their operations, on every thread, and the latencies recorded by a
+    //   thread outlive it
+    size_t period = latencySamplePeriod();
+    setLatencySamplePeriod(1);
+    resetLatencies();
+    rope r = rope(str2);
+    r.insert(3, str1);
+    std::thread([&] { rope copy = r; copy.rdelete(0, 5); }).join();
+    std::thread([&] { rope copy = r; copy.rdelete(0, 5); }).join();
+    CHECK_EQUAL(uint64_t(1), latencySnapshot(rope_op::insert).count());
+    CHECK_EQUAL(uint64_t(2), latencySnapshot(rope_op::rdelete).count());
+    resetLatencies();
+    CHECK_EQUAL(uint64_t(0), latencySnapshot(rope_op::insert).count());
+    CHECK_EQUAL(uint64_t(0), latencySnapshot(rope_op::rdelete).count());
+    
+    // only one operation in each period is timed
+    setLatencySamplePeriod(4);
+    for (size_t i = 0; i < 8; i++) r.substring(0, 4);
+    CHECK_EQUAL(uint64_t(2), latencySnapshot(rope_op::substring).count());
+    setLatencySamplePeriod(period);
+#endif
+  }
+  
+  TEST(TRACE_EVENTS) {
+    // events are recorded only while tracing, and are written as a Chrome trace
+    { trace_span ignored("ignored", 1); }
+    startTracing();
+    CHECK(tracing());
+    { trace_span span("span", 42); }
+    std::thread([] { traceAllocation(7); }).join();
+    stopTracing();
+    { trace_span late("late", 1); }
+    std::ostringstream out;
+    writeTrace(out);
+    string trace = out.str();
+    CHECK(trace.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") == 0);
+    CHECK(trace.find("\"name\":\"span\",\"cat\":\"rope\",\"ph\":\"X\"") != string::npos);
+    CHECK(trace.find("\"args\":{\"bytes\":42}") != string::npos);
+    CHECK(trace.find("\"name\":\"allocate\",\"cat\":\"rope\",\"ph\":\"i\"") != string::npos);
+    CHECK(trace.find("\"args\":{\"bytes\":7}") != string::npos);
+    CHECK(trace.find("ignored") == string::npos);
+    CHECK(trace.find("late") == string::npos);
+    CHECK(trace.find("]}") != string::npos);
+    
+    // starting again discards the events recorded so far
+    startTracing();
+    stopTracing();
+    std::ostringstream empty;
+    writeTrace(empty);
+    CHECK(empty.str().find("span") == string::npos);
+    CHECK(empty.str().find("allocate") == string::npos);
+    
+#ifdef PROJ_TRACE_EVENTS
+    // ropes trace their internal steps
+    startTracing();
+    rope r = rope(str2);
+    r.insert(3, str1);
+    r.rdelete(0, 5);
+    r.balance();
+    r.toString();
+    stopTracing();
+    std::ostringstream steps;
+    writeTrace(steps);
+    for (const char * name : { "\"splitAt\"", "\"balance\"", "\"treeToString\"", "\"allocate\"" }) {
+      CHECK(steps.str().find(name) != string::npos);
+    }
+#endif
+  }
+  
 }  // namespace proj
 
 int